@@ -0,0 +1,316 @@
+// Headless benchmark for the particle simulation. Needs no window or GL context,
+// so it can run on CI machines without a GPU or display.
+//
+// Build (particles_bench target):
+//   g++ -O2 -std=c++17 -pthread bench.cpp simulation.cpp particle.cpp color_kernel.cpp worker_pool.cpp input_log.cpp -o particles_bench
+//
+// Usage:
+//   particles_bench [--scene sand|water|forest|edges|all] [--width N] [--height N]
+//                   [--ticks N] [--warmup N] [--threads N] [--render] [--kernel NAME]
+//                   [--bitboard] [--sleep]
+//   particles_bench --replay session.plog [--threads N] [--render] [--kernel NAME] [--sleep]
+//
+// With --render, Render is also run after every tick and timed separately
+// from ProcessInput/Update. --kernel forces one of the color kernels
+// (scalar, ssse3, avx2, avx512) instead of the default one for this CPU.
+// --bitboard runs the scenes with Simulation::SetBitboardGranular. The edges
+// scene keeps particles moving along the grid's borders, so builds with
+// assertions enabled check the bounds of dirty and damaged rects there.
+// --sleep runs scenes or a replay with Simulation::SetSleepEnabled.
+// --replay runs an input log recorded by the game (particles --record)
+// instead of a scripted scene, and fails unless the final grid matches the
+// recorded one bit for bit. Replays use whichever powder update the log was
+// recorded with.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "color_kernel.h"
+#include "input_log.h"
+#include "simulation.h"
+
+struct BenchOptions {
+	std::string scene = "all";
+	std::string replayPath;
+	unsigned int width = 960;
+	unsigned int height = 640;
+	unsigned int ticks = 1000;
+	unsigned int warmup = 50;
+	unsigned int threads = 1;
+	bool render = false;
+	bool bitboard = false;
+	bool sleep = false;
+	std::string kernel;
+};
+
+struct Scene {
+	const char* name;
+	// Places the initial particles
+	void (*setup)(Simulation& simulation, unsigned int width, unsigned int height);
+	// Drives the mouse/brush before each tick, like a user would
+	void (*script)(Simulation& simulation, unsigned int width, unsigned int height, unsigned int tick);
+};
+
+// Fills the rectangle [x, x + w) x [y, y + h) wherever it is currently empty
+void Fill(Simulation& simulation, ParticleType type, unsigned int x, unsigned int y, unsigned int w, unsigned int h) {
+	simulation.TryCreateInRegion(type, x + w / 2, y + h / 2, (w + 1) / 2, (h + 1) / 2);
+}
+
+void SetupSand(Simulation& simulation, unsigned int width, unsigned int height) {
+	// Blocks of sand in mid air that collapse into piles
+	for (unsigned int x = width / 10; x + width / 10 < width; x += width / 5) {
+		Fill(simulation, ParticleType::SAND, x, height / 3, width / 10, height / 2);
+	}
+}
+
+void ScriptSand(Simulation& simulation, unsigned int width, unsigned int height, unsigned int tick) {
+	// Pour sand from a brush sweeping back and forth near the top
+	unsigned int period = 2 * width;
+	unsigned int phase = (tick * 3) % period;
+	simulation.input.mouseX = phase < width ? phase : period - phase - 1;
+	simulation.input.mouseY = height - height / 8;
+	simulation.input.mouseHeld = true;
+	simulation.input.brushSize = 4;
+	simulation.input.lastNumKeyPressed = 1;
+}
+
+void SetupWater(Simulation& simulation, unsigned int width, unsigned int height) {
+	// Wooden basins filled with water
+	unsigned int basinWidth = width / 4;
+	for (unsigned int x = width / 16; x + basinWidth < width; x += basinWidth + width / 16) {
+		Fill(simulation, ParticleType::WOOD, x, 4, basinWidth, 3);
+		Fill(simulation, ParticleType::WOOD, x, 4, 3, height / 3);
+		Fill(simulation, ParticleType::WOOD, x + basinWidth - 3, 4, 3, height / 3);
+		Fill(simulation, ParticleType::WATER, x + 3, 7, basinWidth - 6, height / 2);
+	}
+}
+
+void ScriptWater(Simulation& simulation, unsigned int width, unsigned int height, unsigned int tick) {
+	// Keep topping up the basins, alternating between two taps
+	simulation.input.mouseX = (tick / 200) % 2 == 0 ? width / 4 : width - width / 4;
+	simulation.input.mouseY = height - height / 6;
+	simulation.input.mouseHeld = tick % 4 == 0;
+	simulation.input.brushSize = 3;
+	simulation.input.lastNumKeyPressed = 2;
+}
+
+void SetupForest(Simulation& simulation, unsigned int width, unsigned int height) {
+	// Rows of trees standing on a wooden floor, set alight from below
+	Fill(simulation, ParticleType::WOOD, 0, 1, width, 3);
+	for (unsigned int x = 6; x + 12 < width; x += 18) {
+		unsigned int treeHeight = height / 4 + (x * 7) % (height / 4);
+		Fill(simulation, ParticleType::WOOD, x + 4, 4, 3, treeHeight);
+		Fill(simulation, ParticleType::WOOD, x, 4 + treeHeight, 11, height / 10);
+	}
+	for (unsigned int x = 0; x < width; x += width / 8) {
+		Fill(simulation, ParticleType::FIRE, x, 4, 4, 2);
+	}
+}
+
+void ScriptForest(Simulation& simulation, unsigned int width, unsigned int height, unsigned int tick) {
+	// Occasionally drop more fire into the canopy
+	simulation.input.mouseX = (tick * 37) % width;
+	simulation.input.mouseY = height / 2;
+	simulation.input.mouseHeld = tick % 50 == 0;
+	simulation.input.brushSize = 2;
+	simulation.input.lastNumKeyPressed = 4;
+}
+
+void SetupEdges(Simulation& simulation, unsigned int width, unsigned int height) {
+	// Two wooden shelves in the top chunk row, the upper one open at the right edge of the grid
+	// and the lower one a column short of it
+	Fill(simulation, ParticleType::WOOD, width - width / 4, height - 4, width / 4 - 1, 1);
+	Fill(simulation, ParticleType::WOOD, width - width / 4, height - 12, width / 4 - 2, 1);
+}
+
+void ScriptEdges(Simulation& simulation, unsigned int width, unsigned int height, unsigned int tick) {
+	// Sand poured onto the upper shelf falls down the last column, past sand rolling
+	// off the lower one, so moves at the edges of the grid and of the top chunk row share rows
+	bool upper = tick % 2 == 0;
+	simulation.input.mouseX = upper ? width - 3 : width - 5;
+	simulation.input.mouseY = upper ? height - 2 : height - 9;
+	simulation.input.mouseHeld = true;
+	simulation.input.brushSize = 1;
+	simulation.input.lastNumKeyPressed = 1;
+}
+
+const Scene SCENES[] = {
+	{ "sand", SetupSand, ScriptSand },
+	{ "water", SetupWater, ScriptWater },
+	{ "forest", SetupForest, ScriptForest },
+	{ "edges", SetupEdges, ScriptEdges },
+};
+
+void PrintTimes(const char* label, std::vector<double>& times, double cells) {
+	double totalNs = 0;
+	for (double t : times) {
+		totalNs += t;
+	}
+	std::sort(times.begin(), times.end());
+	auto percentile = [&times](double p) {
+		size_t index = (size_t)(p * (times.size() - 1) + 0.5);
+		return times[index] / 1e6;
+	};
+
+	std::printf("  %s\n", label);
+	std::printf("    ns/cell/tick %.3f\n", totalNs / times.size() / cells);
+	std::printf("    ticks/sec    %.1f\n", times.size() / (totalNs / 1e9));
+	std::printf("    ms/tick      p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+		percentile(0.5), percentile(0.9), percentile(0.99), times.back() / 1e6);
+}
+
+// Runs warmup + ticks ticks, calling setInput before each one, and prints timings for the last ticks
+void RunTicks(Simulation& simulation, const char* name, unsigned int warmup, unsigned int ticks,
+	const std::function<void(unsigned int)>& setInput, const BenchOptions& options) {
+	std::vector<uint32_t> screenBuffer(options.render ? (size_t)options.width * options.height : 0);
+	std::vector<double> tickTimes, renderTimes;
+	tickTimes.reserve(ticks);
+	renderTimes.reserve(ticks);
+
+	for (unsigned int tick = 0; tick < warmup + ticks; tick++) {
+		setInput(tick);
+
+		auto start = std::chrono::steady_clock::now();
+		simulation.ProcessInput();
+		simulation.Update();
+		auto updated = std::chrono::steady_clock::now();
+		if (options.render) {
+			simulation.Render(screenBuffer.data());
+		}
+		auto rendered = std::chrono::steady_clock::now();
+
+		if (tick >= warmup) {
+			tickTimes.push_back(std::chrono::duration<double, std::nano>(updated - start).count());
+			renderTimes.push_back(std::chrono::duration<double, std::nano>(rendered - updated).count());
+		}
+	}
+
+	double cells = (double)options.width * options.height;
+	std::printf("%-8s %ux%u ticks=%zu threads=%u hash=%016llx\n", name, options.width, options.height,
+		tickTimes.size(), options.threads, (unsigned long long)simulation.Hash());
+	PrintTimes("update", tickTimes, cells);
+	if (options.render) {
+		std::string label = std::string("render (") + GetColorKernelName() + ")";
+		PrintTimes(label.c_str(), renderTimes, cells);
+	}
+}
+
+void RunScene(const Scene& scene, const BenchOptions& options) {
+	Simulation simulation(options.width, options.height, options.threads);
+	simulation.SetBitboardGranular(options.bitboard);
+	simulation.SetSleepEnabled(options.sleep);
+	scene.setup(simulation, options.width, options.height);
+	RunTicks(simulation, scene.name, options.warmup, options.ticks, [&](unsigned int tick) {
+		scene.script(simulation, options.width, options.height, tick);
+	}, options);
+}
+
+bool RunReplay(BenchOptions options) {
+	InputLog log;
+	if (!log.Load(options.replayPath)) {
+		return false;
+	}
+	if (log.GetTickCount() == 0) {
+		std::fprintf(stderr, "Input log has no ticks: %s\n", options.replayPath.c_str());
+		return false;
+	}
+	options.width = log.width;
+	options.height = log.height;
+
+	Simulation simulation(log.width, log.height, options.threads, log.seed);
+	simulation.SetBitboardGranular(log.bitboardGranular);
+	simulation.SetSleepEnabled(options.sleep);
+	size_t span = 0;
+	unsigned int ticksLeftInSpan = log.spans.empty() ? 0 : log.spans[0].ticks;
+	RunTicks(simulation, "replay", 0, (unsigned int)log.GetTickCount(), [&](unsigned int) {
+		while (ticksLeftInSpan == 0) {
+			ticksLeftInSpan = log.spans[++span].ticks;
+		}
+		simulation.input = log.spans[span].input;
+		ticksLeftInSpan--;
+	}, options);
+
+	if (simulation.Hash() != log.finalHash) {
+		std::fprintf(stderr, "Replay diverged: expected hash %016llx\n", (unsigned long long)log.finalHash);
+		return false;
+	}
+	std::printf("  replay matches recorded grid\n");
+	return true;
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions* options) {
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--render") == 0) {
+			options->render = true;
+		} else if (strcmp(arg, "--bitboard") == 0) {
+			options->bitboard = true;
+		} else if (strcmp(arg, "--sleep") == 0) {
+			options->sleep = true;
+		} else if (strcmp(arg, "--kernel") == 0 && hasValue) {
+			options->kernel = argv[++i];
+		} else if (strcmp(arg, "--replay") == 0 && hasValue) {
+			options->replayPath = argv[++i];
+		} else if (strcmp(arg, "--scene") == 0 && hasValue) {
+			options->scene = argv[++i];
+		} else if (strcmp(arg, "--width") == 0 && hasValue) {
+			options->width = strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(arg, "--height") == 0 && hasValue) {
+			options->height = strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(arg, "--ticks") == 0 && hasValue) {
+			options->ticks = strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(arg, "--warmup") == 0 && hasValue) {
+			options->warmup = strtoul(argv[++i], nullptr, 10);
+		} else if (strcmp(arg, "--threads") == 0 && hasValue) {
+			options->threads = strtoul(argv[++i], nullptr, 10);
+		} else {
+			std::fprintf(stderr, "Unknown or incomplete argument: %s\n", arg);
+			return false;
+		}
+	}
+	if (options->width < 64 || options->height < 64 || options->ticks == 0 || options->threads == 0) {
+		std::fprintf(stderr, "Grid must be at least 64x64, ticks and threads must be positive\n");
+		return false;
+	}
+	if (!options->kernel.empty() && !SetColorKernel(options->kernel.c_str())) {
+		std::fprintf(stderr, "Color kernel %s isn't supported here\n", options->kernel.c_str());
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, &options)) {
+		std::fprintf(stderr,
+			"Usage: %s [--scene sand|water|forest|edges|all] [--width N] [--height N] "
+			"[--ticks N] [--warmup N] [--threads N] [--render] [--kernel NAME] [--bitboard] [--sleep]\n"
+			"       %s --replay FILE [--threads N] [--render] [--kernel NAME] [--sleep]\n", argv[0], argv[0]);
+		return 1;
+	}
+
+	if (!options.replayPath.empty()) {
+		return RunReplay(options) ? 0 : 1;
+	}
+
+	bool ranAny = false;
+	for (const Scene& scene : SCENES) {
+		if (options.scene == "all" || options.scene == scene.name) {
+			RunScene(scene, options);
+			ranAny = true;
+		}
+	}
+	if (!ranAny) {
+		std::fprintf(stderr, "Unknown scene: %s\n", options.scene.c_str());
+		return 1;
+	}
+	return 0;
+}
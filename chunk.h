@@ -0,0 +1,65 @@
+#pragma once
+
+#include <limits.h>
+
+#include <atomic>
+
+// The grid is split into CHUNK_SIZE x CHUNK_SIZE chunks so settled regions can be skipped
+constexpr unsigned int CHUNK_SIZE = 32;
+// How far from itself a particle update may read or write. Chunks updated at the
+// same time are a whole chunk apart, so keeping this to half a chunk means they
+// never touch the same cells.
+constexpr int CHUNK_REACH = CHUNK_SIZE / 2;
+
+// Inclusive rectangle of cells, empty when xMin > xMax. Chunks on either side of
+// a chunk can grow its rects from different threads, so the bounds are atomic.
+struct DirtyRect {
+	std::atomic<int> xMin{ INT_MAX }, yMin{ INT_MAX };
+	std::atomic<int> xMax{ INT_MIN }, yMax{ INT_MIN };
+
+	bool IsEmpty() const {
+		return xMin.load(std::memory_order_relaxed) > xMax.load(std::memory_order_relaxed);
+	}
+
+	void Include(int x0, int y0, int x1, int y1) {
+		AtomicMin(xMin, x0);
+		AtomicMin(yMin, y0);
+		AtomicMax(xMax, x1);
+		AtomicMax(yMax, y1);
+	}
+
+	void CopyFrom(const DirtyRect& other) {
+		xMin.store(other.xMin.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		yMin.store(other.yMin.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		xMax.store(other.xMax.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		yMax.store(other.yMax.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+
+	void Clear() {
+		xMin.store(INT_MAX, std::memory_order_relaxed);
+		yMin.store(INT_MAX, std::memory_order_relaxed);
+		xMax.store(INT_MIN, std::memory_order_relaxed);
+		yMax.store(INT_MIN, std::memory_order_relaxed);
+	}
+
+private:
+	static void AtomicMin(std::atomic<int>& value, int candidate) {
+		int current = value.load(std::memory_order_relaxed);
+		while (candidate < current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+	}
+
+	static void AtomicMax(std::atomic<int>& value, int candidate) {
+		int current = value.load(std::memory_order_relaxed);
+		while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {}
+	}
+};
+
+struct Chunk {
+	// Cells to visit this tick. Grows while the tick runs so cells woken by
+	// an earlier cell are still updated in the same tick, as a full sweep would.
+	DirtyRect current;
+	// Cells next to a change made this tick, visited next tick
+	DirtyRect next;
+	// Cells whose type changed since Simulation::TakeDamage last ran
+	DirtyRect damage;
+};
@@ -0,0 +1,209 @@
+#include "color_kernel.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAS_X86_KERNELS 1
+#endif
+
+// The vector kernels look colors up with 16 entry shuffles, one per group of 16
+// types, and AVX-512 holds at most four groups of 16 colors in its tables
+constexpr unsigned int TABLE_GROUPS = (PARTICLE_TYPE_COUNT + 15) / 16;
+static_assert(TABLE_GROUPS <= 4, "the color kernels handle at most 64 particle types");
+
+typedef void (*ColorKernel)(const ParticleType* types, uint32_t* pixels, unsigned int count);
+
+void ColorizeScalar(const ParticleType* types, uint32_t* pixels, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		pixels[i] = PARTICLE_COLORS[(uint8_t)types[i]];
+	}
+}
+
+#ifdef HAS_X86_KERNELS
+// PARTICLE_COLORS split into one 16 byte table per group and channel, as pshufb wants them
+struct ChannelTables {
+	alignas(16) uint8_t channels[TABLE_GROUPS][4][16];
+
+	ChannelTables() {
+		memset(channels, 0, sizeof(channels));
+		for (unsigned int type = 0; type < PARTICLE_TYPE_COUNT; type++) {
+			for (unsigned int channel = 0; channel < 4; channel++) {
+				channels[type / 16][channel][type % 16] = (uint8_t)(PARTICLE_COLORS[type] >> (8 * channel));
+			}
+		}
+	}
+};
+
+const ChannelTables& GetChannelTables() {
+	static const ChannelTables tables;
+	return tables;
+}
+
+// pshufb looks up the low four bits of each index and gives 0 where the top bit is set.
+// Moving the group's types down to 0-15 and adding 0x70 with saturation sets the top
+// bit for every other type, so ORing the lookups of all groups leaves the right color.
+constexpr char GROUP_INDEX_BIAS = 0x70;
+
+__attribute__((target("ssse3")))
+void ColorizeSsse3(const ParticleType* types, uint32_t* pixels, unsigned int count) {
+	const ChannelTables& tables = GetChannelTables();
+	__m128i red[TABLE_GROUPS], green[TABLE_GROUPS], blue[TABLE_GROUPS], alpha[TABLE_GROUPS];
+	for (unsigned int group = 0; group < TABLE_GROUPS; group++) {
+		red[group] = _mm_load_si128((const __m128i*)tables.channels[group][0]);
+		green[group] = _mm_load_si128((const __m128i*)tables.channels[group][1]);
+		blue[group] = _mm_load_si128((const __m128i*)tables.channels[group][2]);
+		alpha[group] = _mm_load_si128((const __m128i*)tables.channels[group][3]);
+	}
+	__m128i bias = _mm_set1_epi8(GROUP_INDEX_BIAS);
+
+	unsigned int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i index = _mm_loadu_si128((const __m128i*)(types + i));
+		// Look each channel up for all 16 cells, then interleave the channels back into pixels
+		__m128i r = _mm_setzero_si128(), g = _mm_setzero_si128(), b = _mm_setzero_si128(), a = _mm_setzero_si128();
+		for (unsigned int group = 0; group < TABLE_GROUPS; group++) {
+			__m128i groupIndex = _mm_adds_epu8(_mm_sub_epi8(index, _mm_set1_epi8((char)(16 * group))), bias);
+			r = _mm_or_si128(r, _mm_shuffle_epi8(red[group], groupIndex));
+			g = _mm_or_si128(g, _mm_shuffle_epi8(green[group], groupIndex));
+			b = _mm_or_si128(b, _mm_shuffle_epi8(blue[group], groupIndex));
+			a = _mm_or_si128(a, _mm_shuffle_epi8(alpha[group], groupIndex));
+		}
+		__m128i rgLow = _mm_unpacklo_epi8(r, g);
+		__m128i rgHigh = _mm_unpackhi_epi8(r, g);
+		__m128i baLow = _mm_unpacklo_epi8(b, a);
+		__m128i baHigh = _mm_unpackhi_epi8(b, a);
+		_mm_storeu_si128((__m128i*)(pixels + i), _mm_unpacklo_epi16(rgLow, baLow));
+		_mm_storeu_si128((__m128i*)(pixels + i + 4), _mm_unpackhi_epi16(rgLow, baLow));
+		_mm_storeu_si128((__m128i*)(pixels + i + 8), _mm_unpacklo_epi16(rgHigh, baHigh));
+		_mm_storeu_si128((__m128i*)(pixels + i + 12), _mm_unpackhi_epi16(rgHigh, baHigh));
+	}
+	ColorizeScalar(types + i, pixels + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void ColorizeAvx2(const ParticleType* types, uint32_t* pixels, unsigned int count) {
+	const ChannelTables& tables = GetChannelTables();
+	__m256i red[TABLE_GROUPS], green[TABLE_GROUPS], blue[TABLE_GROUPS], alpha[TABLE_GROUPS];
+	for (unsigned int group = 0; group < TABLE_GROUPS; group++) {
+		red[group] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)tables.channels[group][0]));
+		green[group] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)tables.channels[group][1]));
+		blue[group] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)tables.channels[group][2]));
+		alpha[group] = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)tables.channels[group][3]));
+	}
+	__m256i bias = _mm256_set1_epi8(GROUP_INDEX_BIAS);
+
+	unsigned int i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i index = _mm256_loadu_si256((const __m256i*)(types + i));
+		__m256i r = _mm256_setzero_si256(), g = _mm256_setzero_si256(), b = _mm256_setzero_si256(), a = _mm256_setzero_si256();
+		for (unsigned int group = 0; group < TABLE_GROUPS; group++) {
+			__m256i groupIndex = _mm256_adds_epu8(_mm256_sub_epi8(index, _mm256_set1_epi8((char)(16 * group))), bias);
+			r = _mm256_or_si256(r, _mm256_shuffle_epi8(red[group], groupIndex));
+			g = _mm256_or_si256(g, _mm256_shuffle_epi8(green[group], groupIndex));
+			b = _mm256_or_si256(b, _mm256_shuffle_epi8(blue[group], groupIndex));
+			a = _mm256_or_si256(a, _mm256_shuffle_epi8(alpha[group], groupIndex));
+		}
+		// Unpacking works within 128 bit lanes, so the low lane ends up holding
+		// cells 0-15 and the high lane cells 16-31, four pixels per register
+		__m256i rgLow = _mm256_unpacklo_epi8(r, g);
+		__m256i rgHigh = _mm256_unpackhi_epi8(r, g);
+		__m256i baLow = _mm256_unpacklo_epi8(b, a);
+		__m256i baHigh = _mm256_unpackhi_epi8(b, a);
+		__m256i pixels0 = _mm256_unpacklo_epi16(rgLow, baLow);
+		__m256i pixels4 = _mm256_unpackhi_epi16(rgLow, baLow);
+		__m256i pixels8 = _mm256_unpacklo_epi16(rgHigh, baHigh);
+		__m256i pixels12 = _mm256_unpackhi_epi16(rgHigh, baHigh);
+		_mm256_storeu_si256((__m256i*)(pixels + i), _mm256_permute2x128_si256(pixels0, pixels4, 0x20));
+		_mm256_storeu_si256((__m256i*)(pixels + i + 8), _mm256_permute2x128_si256(pixels8, pixels12, 0x20));
+		_mm256_storeu_si256((__m256i*)(pixels + i + 16), _mm256_permute2x128_si256(pixels0, pixels4, 0x31));
+		_mm256_storeu_si256((__m256i*)(pixels + i + 24), _mm256_permute2x128_si256(pixels8, pixels12, 0x31));
+	}
+	ColorizeScalar(types + i, pixels + i, count - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+void ColorizeAvx512(const ParticleType* types, uint32_t* pixels, unsigned int count) {
+	// Cells widened to 32 bits index 16 colors in one register directly with vpermd,
+	// 32 in a pair with vpermi2d, and bit 5 picks between two pairs for up to 64
+	alignas(64) uint32_t colors[64] = {};
+	memcpy(colors, PARTICLE_COLORS.data(), sizeof(uint32_t) * PARTICLE_TYPE_COUNT);
+	__m512i tables[4];
+	for (unsigned int table = 0; table < 4; table++) {
+		tables[table] = _mm512_load_si512(colors + 16 * table);
+	}
+	__m512i highPairBit = _mm512_set1_epi32(32);
+
+	// The zero masked forms compile the same, but GCC 12's headers fill the unmasked ones from an
+	// uninitialized register and trip -Wmaybe-uninitialized
+	const __mmask16 all = 0xFFFF;
+	unsigned int i = 0;
+	for (; i + 64 <= count; i += 64) {
+		for (unsigned int j = 0; j < 64; j += 16) {
+			__m512i index = _mm512_maskz_cvtepu8_epi32(all, _mm_loadu_si128((const __m128i*)(types + i + j)));
+			__m512i color;
+			if (TABLE_GROUPS == 1) {
+				color = _mm512_maskz_permutexvar_epi32(all, index, tables[0]);
+			} else {
+				color = _mm512_permutex2var_epi32(tables[0], index, tables[1]);
+				if (TABLE_GROUPS > 2) {
+					__m512i high = _mm512_permutex2var_epi32(tables[2], index, tables[3]);
+					color = _mm512_mask_mov_epi32(color, _mm512_test_epi32_mask(index, highPairBit), high);
+				}
+			}
+			_mm512_storeu_si512(pixels + i + j, color);
+		}
+	}
+	ColorizeScalar(types + i, pixels + i, count - i);
+}
+#endif
+
+struct KernelOption {
+	const char* name;
+	ColorKernel kernel;
+	bool (*supported)();
+};
+
+const KernelOption KERNELS[] = {
+#ifdef HAS_X86_KERNELS
+	{ "avx2", ColorizeAvx2, []() { return __builtin_cpu_supports("avx2") != 0; } },
+	{ "avx512", ColorizeAvx512, []() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"); } },
+	{ "ssse3", ColorizeSsse3, []() { return __builtin_cpu_supports("ssse3") != 0; } },
+#endif
+	{ "scalar", ColorizeScalar, []() { return true; } },
+};
+
+// The first supported kernel is the default. AVX2 comes ahead of AVX-512: with up to 16 types the
+// colorizer is bound by stores either way, and 512 bit instructions can drop the clock of the core
+// running them, which the simulation pays for. SetColorKernel still picks avx512 on request.
+const KernelOption* selectedKernel = nullptr;
+
+const KernelOption* GetSelectedKernel() {
+	if (!selectedKernel) {
+		for (const KernelOption& option : KERNELS) {
+			if (option.supported()) {
+				selectedKernel = &option;
+				break;
+			}
+		}
+	}
+	return selectedKernel;
+}
+
+void ColorizeRow(const ParticleType* types, uint32_t* pixels, unsigned int count) {
+	GetSelectedKernel()->kernel(types, pixels, count);
+}
+
+const char* GetColorKernelName() {
+	return GetSelectedKernel()->name;
+}
+
+bool SetColorKernel(const char* name) {
+	for (const KernelOption& option : KERNELS) {
+		if (strcmp(option.name, name) == 0 && option.supported()) {
+			selectedKernel = &option;
+			return true;
+		}
+	}
+	return false;
+}
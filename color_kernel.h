@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "particle.h"
+
+// Colors count cells of types into pixels with PARTICLE_COLORS. Uses the preferred
+// vector kernel the CPU supports (AVX2 ahead of AVX-512), picked the first time it's called.
+void ColorizeRow(const ParticleType* types, uint32_t* pixels, unsigned int count);
+
+// Name of the kernel ColorizeRow uses: "scalar", "ssse3", "avx2" or "avx512"
+const char* GetColorKernelName();
+// Switches ColorizeRow to the named kernel, returning false if this CPU or build can't run it
+bool SetColorKernel(const char* name);
@@ -0,0 +1,36 @@
+#include "fixed_timestep.h"
+
+#include <algorithm>
+
+// Lets a tick run when rounding leaves the accumulator a hair short of a whole period
+constexpr double TICK_EPSILON = 1e-6;
+
+FixedTimestep::FixedTimestep(double tickRate, unsigned int maxTicksPerStep) :
+	tickPeriod(1.0 / tickRate), maxTicksPerStep(std::max(maxTicksPerStep, 1u)) {
+}
+
+unsigned int FixedTimestep::Advance(double elapsed) {
+	accumulator += elapsed;
+	unsigned int ticks = (unsigned int)std::min(accumulator / tickPeriod + TICK_EPSILON, (double)maxTicksPerStep);
+	accumulator = std::max(accumulator - ticks * tickPeriod, 0.0);
+
+	double maxBacklog = maxTicksPerStep * tickPeriod;
+	if (accumulator > maxBacklog) {
+		uint64_t dropped = (uint64_t)((accumulator - maxBacklog) / tickPeriod);
+		droppedTicks += dropped;
+		accumulator -= dropped * tickPeriod;
+	}
+	return ticks;
+}
+
+double FixedTimestep::GetTimeToNextTick() {
+	return std::max(tickPeriod - accumulator, 0.0);
+}
+
+float FixedTimestep::GetLag() {
+	return (float)(accumulator / tickPeriod);
+}
+
+uint64_t FixedTimestep::GetDroppedTicks() {
+	return droppedTicks;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+constexpr double DEFAULT_TICK_RATE = 60.0;
+constexpr unsigned int DEFAULT_MAX_TICKS_PER_STEP = 4;
+
+// Turns elapsed wall time into a number of fixed length ticks to run.
+// At most maxTicksPerStep ticks are handed out per step and at most that
+// many more are kept as backlog, anything further behind is dropped, so a
+// machine that can't keep up runs the simulation slower instead of falling
+// ever further behind.
+class FixedTimestep {
+public:
+	FixedTimestep(double tickRate = DEFAULT_TICK_RATE, unsigned int maxTicksPerStep = DEFAULT_MAX_TICKS_PER_STEP);
+
+	// Adds elapsed seconds and returns how many ticks to run now
+	unsigned int Advance(double elapsed);
+	// Seconds until the next tick is due, 0 if one already is
+	double GetTimeToNextTick();
+	// How many ticks behind real time the simulation is, below 1 when keeping up
+	float GetLag();
+	// Ticks skipped in total because the backlog was full
+	uint64_t GetDroppedTicks();
+
+private:
+	double tickPeriod;
+	unsigned int maxTicksPerStep;
+	double accumulator = 0;
+	uint64_t droppedTicks = 0;
+};
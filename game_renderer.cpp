@@ -0,0 +1,207 @@
+#include "game_renderer.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "resource_manager.h"
+
+// Same as in game_indexed.fs
+constexpr unsigned int MAX_PALETTE_SIZE = 64;
+static_assert(PARTICLE_TYPE_COUNT <= MAX_PALETTE_SIZE, "game_indexed.fs needs a bigger palette for this many particle types");
+
+glm::vec4 ColorToVec4(uint32_t color) {
+	return glm::vec4(
+		(color & 0xFF) / 255.0f,
+		((color >> 8) & 0xFF) / 255.0f,
+		((color >> 16) & 0xFF) / 255.0f,
+		((color >> 24) & 0xFF) / 255.0f);
+}
+
+GameRenderer::GameRenderer(unsigned int width, unsigned int height, RenderMode mode) :
+	width(width), height(height), mode(mode) {
+	float vertices[] = {
+		 1.0f,  1.0f,   1.0f, 1.0f,
+		 1.0f, -1.0f,   1.0f, 0.0f,
+		-1.0f, -1.0f,   0.0f, 0.0f,
+		-1.0f,  1.0f,   0.0f, 1.0f,
+	};
+	unsigned int indices[] = {
+				0, 1, 3, // first triangle
+				1, 2, 3  // second triangle
+	};
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	glBindVertexArray(VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	// position attribute
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	// texture coord attribute
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	if (mode == RenderMode::RGBA) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Storage is allocated once, frames are streamed into it through the pixel buffers
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		for (PixelBuffer& pixelBuffer : pixelBuffers) {
+			glGenBuffers(1, &pixelBuffer.id);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.id);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, sizeof(uint32_t) * width * height, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		shader = ResourceManager::LoadShader("resources/shaders/game.vs", "resources/shaders/game.fs", nullptr, "game");
+		ResourceManager::GetShader(shader).Use().SetInteger("tex", 0);
+	} else {
+		// Integer textures can't be filtered
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+
+		shader = ResourceManager::LoadShader("resources/shaders/game_indexed.vs", "resources/shaders/game_indexed.fs", nullptr, "game_indexed");
+		const Shader& program = ResourceManager::GetShader(shader);
+		program.Use().SetInteger("types", 0);
+		// The palette never changes, so it is only set once
+		for (unsigned int i = 0; i < PARTICLE_TYPE_COUNT; i++) {
+			program.SetVector4f(("palette[" + std::to_string(i) + "]").c_str(), ColorToVec4(PARTICLE_COLORS[i]));
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GameRenderer::~GameRenderer() {
+	for (PixelBuffer& pixelBuffer : pixelBuffers) {
+		if (pixelBuffer.fence) {
+			glDeleteSync(pixelBuffer.fence);
+		}
+		if (pixelBuffer.id) {
+			glDeleteBuffers(1, &pixelBuffer.id);
+		}
+	}
+	glDeleteTextures(1, &texture);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+FrameFormat GameRenderer::GetFrameFormat() {
+	return mode == RenderMode::RGBA ? FrameFormat::PIXELS : FrameFormat::TYPES;
+}
+
+void GameRenderer::Upload(const Frame& frame) {
+	// Damage is relative to the previous frame, so it's only enough if no frame was skipped
+	if (uploadedOnce && frame.sequence == lastSequence + 1) {
+		damage = frame.damage;
+	} else {
+		damage.assign(1, { 0, 0, width, height });
+	}
+	uploadedOnce = true;
+	lastSequence = frame.sequence;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (mode == RenderMode::RGBA) {
+		UploadRgba(frame);
+	} else {
+		UploadIndexed(frame);
+
+		const CellRect& cursor = frame.cursorRect;
+		const Shader& program = ResourceManager::GetShader(shader).Use();
+		program.SetVector4f("cursorRect", (float)cursor.x, (float)cursor.y,
+			(float)(cursor.x + cursor.width - 1), (float)(cursor.y + cursor.height - 1));
+		program.SetVector4f("cursorColor", ColorToVec4(PARTICLE_CURSOR_COLORS[(uint8_t)frame.typeSelected]));
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GameRenderer::Draw() {
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	ResourceManager::GetShader(shader).Use();
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+void GameRenderer::UploadRgba(const Frame& frame) {
+	GLsizeiptr size = 0;
+	for (const CellRect& rect : damage) {
+		size += sizeof(uint32_t) * rect.width * rect.height;
+	}
+	if (size == 0) {
+		return;
+	}
+
+	PixelBuffer& pixelBuffer = pixelBuffers[nextPixelBuffer];
+	nextPixelBuffer = (nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+
+	// Wait for the upload that last used this buffer, PIXEL_BUFFER_COUNT frames ago,
+	// so the buffer can be mapped unsynchronized without stalling the whole pipeline
+	if (pixelBuffer.fence) {
+		glClientWaitSync(pixelBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(pixelBuffer.fence);
+		pixelBuffer.fence = nullptr;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.id);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped) {
+		// Each damaged rect is packed tightly after the previous one, so only
+		// the changed pixels are copied and transferred
+		uint32_t* pixels = (uint32_t*)mapped;
+		for (const CellRect& rect : damage) {
+			for (unsigned int y = rect.y; y < rect.y + rect.height; y++) {
+				memcpy(pixels, &frame.pixels[y * width + rect.x], sizeof(uint32_t) * rect.width);
+				pixels += rect.width;
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		size_t offset = 0;
+		for (const CellRect& rect : damage) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)offset);
+			offset += sizeof(uint32_t) * rect.width * rect.height;
+		}
+		pixelBuffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return;
+	}
+
+	// Without a mapped buffer, upload straight from the frame
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	for (const CellRect& rect : damage) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RGBA, GL_UNSIGNED_BYTE,
+			&frame.pixels[rect.y * width + rect.x]);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void GameRenderer::UploadIndexed(const Frame& frame) {
+	// The type plane is already laid out like the texture, so rects are read out of it in place
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	for (const CellRect& rect : damage) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+			&frame.types[rect.y * width + rect.x]);
+	}
+	// Back to GL's defaults so later uploads don't inherit them
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "resource_manager.h"
+#include "simulation.h"
+#include "simulation_thread.h"
+
+enum class RenderMode {
+	// Frames are colored by Simulation::Render on the simulation thread and uploaded as RGBA8
+	RGBA,
+	// The one byte per cell type plane is uploaded as R8UI and colored in game_indexed.fs
+	INDEXED,
+};
+
+// Frames in flight for RGBA uploads, so the CPU never writes a buffer the GPU is still reading
+constexpr unsigned int PIXEL_BUFFER_COUNT = 3;
+
+// A pixel unpack buffer and the fence of the last upload that read from it
+struct PixelBuffer {
+	unsigned int id = 0;
+	GLsync fence = nullptr;
+};
+
+// Draws the simulation grid as a full screen quad
+class GameRenderer {
+public:
+	GameRenderer(unsigned int width, unsigned int height, RenderMode mode);
+	~GameRenderer();
+
+	// The frames this renderer expects SimulationThread to publish
+	FrameFormat GetFrameFormat();
+	// Updates the texture to match frame, uploading only what changed if it follows the last frame
+	void Upload(const Frame& frame);
+	// Draws the last uploaded frame
+	void Draw();
+
+private:
+	unsigned int width, height;
+	RenderMode mode;
+	unsigned int VAO, VBO, EBO;
+	unsigned int texture;
+	ShaderHandle shader;
+	PixelBuffer pixelBuffers[PIXEL_BUFFER_COUNT];
+	unsigned int nextPixelBuffer = 0;
+	// Areas of the grid to upload for the current frame
+	std::vector<CellRect> damage;
+	// The texture starts out undefined, so the first frame uploads everything
+	bool uploadedOnce = false;
+	uint64_t lastSequence = 0;
+
+	void UploadRgba(const Frame& frame);
+	void UploadIndexed(const Frame& frame);
+};
@@ -0,0 +1,101 @@
+#include "input_log.h"
+
+#include <fstream>
+#include <iostream>
+
+// File layout, little endian:
+//   "PLOG", version, width, height, seed, bitboardGranular, finalHash, span count
+//   per span: ticks, mouseX, mouseY, brushSize, lastNumKeyPressed, mouseHeld
+constexpr char LOG_MAGIC[4] = { 'P', 'L', 'O', 'G' };
+constexpr uint32_t LOG_VERSION = 2;
+// Logs from before bitboardGranular was recorded, which always ran without it
+constexpr uint32_t LOG_VERSION_CELLS_ONLY = 1;
+
+template <typename T>
+void WriteValue(std::ofstream& file, T value) {
+	file.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+T ReadValue(std::ifstream& file) {
+	T value = T();
+	file.read((char*)&value, sizeof(T));
+	return value;
+}
+
+void InputLog::Record(const InputState& input) {
+	if (!spans.empty() && spans.back().input == input && spans.back().ticks < UINT32_MAX) {
+		spans.back().ticks++;
+	} else {
+		spans.push_back({ input, 1 });
+	}
+}
+
+uint64_t InputLog::GetTickCount() {
+	uint64_t ticks = 0;
+	for (const Span& span : spans) {
+		ticks += span.ticks;
+	}
+	return ticks;
+}
+
+bool InputLog::Save(const std::string& path) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to open input log for writing: " << path << std::endl;
+		return false;
+	}
+
+	file.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+	WriteValue<uint32_t>(file, LOG_VERSION);
+	WriteValue<uint32_t>(file, width);
+	WriteValue<uint32_t>(file, height);
+	WriteValue<uint64_t>(file, seed);
+	WriteValue<uint8_t>(file, bitboardGranular);
+	WriteValue<uint64_t>(file, finalHash);
+	WriteValue<uint32_t>(file, (uint32_t)spans.size());
+	for (const Span& span : spans) {
+		WriteValue<uint32_t>(file, span.ticks);
+		WriteValue<uint16_t>(file, (uint16_t)span.input.mouseX);
+		WriteValue<uint16_t>(file, (uint16_t)span.input.mouseY);
+		WriteValue<uint8_t>(file, (uint8_t)span.input.brushSize);
+		WriteValue<uint8_t>(file, (uint8_t)span.input.lastNumKeyPressed);
+		WriteValue<uint8_t>(file, span.input.mouseHeld);
+	}
+	return (bool)file;
+}
+
+bool InputLog::Load(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[sizeof(LOG_MAGIC)] = {};
+	file.read(magic, sizeof(magic));
+	uint32_t version = ReadValue<uint32_t>(file);
+	if (!file || std::string(magic, sizeof(magic)) != std::string(LOG_MAGIC, sizeof(LOG_MAGIC)) ||
+		(version != LOG_VERSION && version != LOG_VERSION_CELLS_ONLY)) {
+		std::cout << "Not a supported input log: " << path << std::endl;
+		return false;
+	}
+
+	width = ReadValue<uint32_t>(file);
+	height = ReadValue<uint32_t>(file);
+	seed = ReadValue<uint64_t>(file);
+	bitboardGranular = version != LOG_VERSION_CELLS_ONLY && ReadValue<uint8_t>(file) != 0;
+	finalHash = ReadValue<uint64_t>(file);
+	uint32_t spanCount = ReadValue<uint32_t>(file);
+	spans.clear();
+	for (uint32_t i = 0; i < spanCount && file; i++) {
+		Span span;
+		span.ticks = ReadValue<uint32_t>(file);
+		span.input.mouseX = ReadValue<uint16_t>(file);
+		span.input.mouseY = ReadValue<uint16_t>(file);
+		span.input.brushSize = ReadValue<uint8_t>(file);
+		span.input.lastNumKeyPressed = ReadValue<uint8_t>(file);
+		span.input.mouseHeld = ReadValue<uint8_t>(file) != 0;
+		spans.push_back(span);
+	}
+	if (!file) {
+		std::cout << "Input log is truncated: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+// The input a Simulation saw on each tick, plus what is needed to rebuild it.
+// Consecutive ticks with identical input share one span, so idle stretches of
+// a session cost a few bytes.
+class InputLog {
+public:
+	struct Span {
+		InputState input;
+		uint32_t ticks;
+	};
+
+	unsigned int width = 0, height = 0;
+	uint64_t seed = DEFAULT_SEED;
+	// Simulation::SetBitboardGranular, which changes how piles settle
+	bool bitboardGranular = false;
+	// Simulation::Hash after the last recorded tick
+	uint64_t finalHash = 0;
+	std::vector<Span> spans;
+
+	void Record(const InputState& input);
+	uint64_t GetTickCount();
+	bool Save(const std::string& path);
+	bool Load(const std::string& path);
+};
@@ -1,8 +1,15 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <iostream>
+#include <thread>
 
+#include "game_renderer.h"
+#include "input_log.h"
 #include "simulation.h"
+#include "simulation_thread.h"
 #include "resource_manager.h"
 
 constexpr unsigned int SCREEN_WIDTH = 960;
@@ -11,7 +18,9 @@ constexpr unsigned int GAME_SCALE_FACTOR = 4;
 constexpr unsigned int GAME_WIDTH = SCREEN_WIDTH / GAME_SCALE_FACTOR;
 constexpr unsigned int GAME_HEIGHT = SCREEN_HEIGHT / GAME_SCALE_FACTOR;
 
-Simulation simulation(GAME_WIDTH, GAME_HEIGHT);
+Simulation simulation(GAME_WIDTH, GAME_HEIGHT, std::thread::hardware_concurrency());
+// Written by the GLFW callbacks and handed to the simulation thread every frame
+InputState input;
 
 void ErrorCallback(int error, const char* description);
 void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -19,7 +28,45 @@ void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void MousePositionCallback(GLFWwindow* window, double xPos, double yPos);
 void ScrollWheelCallback(GLFWwindow* window, double xoffset, double yoffset);
 
-int main() {
+int main(int argc, char** argv) {
+	// --record FILE saves every tick's input so particles_bench --replay can reproduce the session.
+	// --indexed uploads the particle types and colors them on the GPU instead of uploading RGBA.
+	// --tick-rate sets the simulation ticks per second, independent of the refresh rate.
+	// --max-ticks caps how many ticks may run back to back to catch up after a slow one.
+	// --watch-shaders recompiles shaders when their files are saved, without restarting the simulation.
+	// --bitboard moves sand a chunk row at a time with bitwise ops instead of cell by cell.
+	// --sleep skips particles that have settled until something next to them changes.
+	const char* recordPath = nullptr;
+	bool watchShaders = false;
+	RenderMode renderMode = RenderMode::RGBA;
+	double tickRate = DEFAULT_TICK_RATE;
+	unsigned int maxTicksPerStep = DEFAULT_MAX_TICKS_PER_STEP;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--indexed") == 0) {
+			renderMode = RenderMode::INDEXED;
+		} else if (strcmp(argv[i], "--watch-shaders") == 0) {
+			watchShaders = true;
+		} else if (strcmp(argv[i], "--bitboard") == 0) {
+			simulation.SetBitboardGranular(true);
+		} else if (strcmp(argv[i], "--sleep") == 0) {
+			simulation.SetSleepEnabled(true);
+		} else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+			tickRate = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--max-ticks") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			maxTicksPerStep = atoi(argv[++i]);
+		} else {
+			std::cout << "Usage: " << argv[0] << " [--record FILE] [--indexed] [--tick-rate N] [--max-ticks N] [--watch-shaders] [--bitboard] [--sleep]" << std::endl;
+			return -1;
+		}
+	}
+	InputLog inputLog;
+	inputLog.width = GAME_WIDTH;
+	inputLog.height = GAME_HEIGHT;
+	inputLog.seed = DEFAULT_SEED;
+	inputLog.bitboardGranular = simulation.IsBitboardGranular();
+
 	// BEGIN INIT GLFW
 	glfwSetErrorCallback(ErrorCallback);
 	if (!glfwInit()) {
@@ -52,91 +99,49 @@ int main() {
 	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 	// END INIT GLFW
 
-	ResourceManager::LoadShader("resources/shaders/game.vs", "resources/shaders/game.fs", nullptr, "game");
-
-	float vertices[] = {
-		 1.0f,  1.0f,   1.0f, 1.0f,
-		 1.0f, -1.0f,   1.0f, 0.0f,
-		-1.0f, -1.0f,   0.0f, 0.0f,
-		-1.0f,  1.0f,   0.0f, 1.0f,
-	};
-	unsigned int indices[] = {
-				0, 1, 3, // first triangle
-				1, 2, 3  // second triangle
-	};
-	unsigned int VBO, VAO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// position attribute
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	// texture coord attribute
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	ResourceManager::GetShader("game").Use().SetInteger("tex", 0);
+	// Shader compiles dominate startup on software GL, so linked programs are cached between launches
+	ResourceManager::SetProgramCacheDirectory("resources/cache/");
+	if (watchShaders) {
+		ResourceManager::WatchShaderFiles();
+	}
+	GameRenderer* renderer = new GameRenderer(GAME_WIDTH, GAME_HEIGHT, renderMode);
+
+	SimulationThread simulationThread(simulation, renderer->GetFrameFormat(), recordPath ? &inputLog : nullptr,
+		FixedTimestep(tickRate, maxTicksPerStep));
 
 	float deltaTime = 0.0f;
 	float lastFrame = 0.0f;
+	float lag = 0.0f;
+	uint64_t droppedTicks = 0;
 	simulation.Init();
-	void* screenBuffer = malloc(sizeof(uint32_t) * GAME_WIDTH * GAME_HEIGHT);
+	simulationThread.Start();
 	while (!glfwWindowShouldClose(window)) {
 		float currentFrame = (float)glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		glfwPollEvents();
+		simulationThread.SetInput(input);
+		ResourceManager::ReloadChangedShaders();
 
-		simulation.ProcessInput();
-		simulation.Update();
-
+		if (simulationThread.AcquireFrame()) {
+			renderer->Upload(simulationThread.GetFrame());
+			lag = simulationThread.GetFrame().lag;
+			droppedTicks = simulationThread.GetFrame().droppedTicks;
+		}
 		glClear(GL_COLOR_BUFFER_BIT);
-		simulation.Render(screenBuffer);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RGBA,
-			GAME_WIDTH,
-			GAME_HEIGHT,
-			0,
-			GL_RGBA,
-			GL_UNSIGNED_BYTE,
-			screenBuffer);
-
-		ResourceManager::GetShader("game").Use();
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		simulation.RenderUi(deltaTime);
+		renderer->Draw();
+		simulation.RenderUi(deltaTime, lag, droppedTicks);
 
 		glfwSwapBuffers(window);
 	}
+	simulationThread.Stop();
 
-	free(screenBuffer);
+	if (recordPath) {
+		inputLog.finalHash = simulation.Hash();
+		inputLog.Save(recordPath);
+	}
 
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	delete renderer;
 	ResourceManager::Clear();
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -159,19 +164,19 @@ void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 	}
 
 	if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
-		simulation.lastNumKeyPressed = key - GLFW_KEY_1 + 1;
+		input.lastNumKeyPressed = key - GLFW_KEY_1 + 1;
 	}
 }
 
 void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 	if (button == GLFW_MOUSE_BUTTON_1) {
 		if (action == GLFW_PRESS) {
-			simulation.mouseHeld = true;
+			input.mouseHeld = true;
 		} else if (action == GLFW_RELEASE) {
-			simulation.mouseHeld = false;
+			input.mouseHeld = false;
 		}
 	} else if (button == GLFW_MOUSE_BUTTON_3 && action == GLFW_PRESS) {
-		simulation.brushSize = 2; // Restore to default
+		input.brushSize = 2; // Restore to default
 	}
 }
 
@@ -182,13 +187,13 @@ void MousePositionCallback(GLFWwindow* window, double xPos, double yPos) {
 	if (xPos < 0 || yPos <= 0 || xPos >= SCREEN_WIDTH || yPos > SCREEN_HEIGHT) {
 		return;
 	}
-	simulation.mouseX = (unsigned int)xPos / GAME_SCALE_FACTOR;
-	simulation.mouseY = (SCREEN_HEIGHT - (unsigned int)yPos) / GAME_SCALE_FACTOR;
+	input.mouseX = (unsigned int)xPos / GAME_SCALE_FACTOR;
+	input.mouseY = (SCREEN_HEIGHT - (unsigned int)yPos) / GAME_SCALE_FACTOR;
 }
 
 void ScrollWheelCallback(GLFWwindow* window, double xOffset, double yOffset) {
-	int newBrushSize = simulation.brushSize + (int)yOffset;
+	int newBrushSize = input.brushSize + (int)yOffset;
 	if (newBrushSize > 0 && newBrushSize < 25) {
-		simulation.brushSize = newBrushSize;
+		input.brushSize = newBrushSize;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAS_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef HAS_MMAP
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view != MAP_FAILED) {
+			data = (const unsigned char*)view;
+			size = (size_t)info.st_size;
+			mapped = true;
+		}
+	}
+	close(fd);
+	if (mapped) {
+		return;
+	}
+#endif
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return;
+	}
+	buffer.resize((size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	if (!file.read((char*)buffer.data(), buffer.size())) {
+		buffer.clear();
+		return;
+	}
+	data = buffer.data();
+	size = buffer.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+	if (mapped) {
+		munmap((void*)data, size);
+	}
+#endif
+}
+
+bool MappedFile::IsOpen() {
+	return data != nullptr;
+}
+
+const unsigned char* MappedFile::GetData() {
+	return data;
+}
+
+size_t MappedFile::GetSize() {
+	return size;
+}
+
+bool WriteFileAtomically(const std::string& path, const std::function<void(std::ofstream& file)>& write) {
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	if (!directory.empty()) {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+	}
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream file(temporaryPath, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	write(file);
+	file.close();
+	if (!file || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A read only view of a whole file. The file is memory mapped where the platform
+// supports it, so only the pages actually touched are read in, and read into
+// memory otherwise.
+class MappedFile {
+public:
+	MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// False if the file couldn't be opened, in which case it has no data
+	bool IsOpen();
+	const unsigned char* GetData();
+	size_t GetSize();
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+	// Holds the contents when the file couldn't be mapped
+	std::vector<unsigned char> buffer;
+};
+
+// Writes a whole file through write, into a temporary file that then replaces path, so an
+// interrupted write never leaves a torn file behind. Creates path's directory if need be.
+// Returns false, leaving whatever was at path before, if any of it failed.
+bool WriteFileAtomically(const std::string& path, const std::function<void(std::ofstream& file)>& write);
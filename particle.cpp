@@ -1,17 +1,57 @@
 #include "particle.h"
-#include <stdlib.h>
 
-Particle::Particle() {}
+constexpr uint32_t Rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+	return r + (g << 8) + (b << 16) + (a << 24);
+}
+
+// Alpha of the brush preview
+constexpr uint32_t CURSOR_ALPHA = 128;
+
+// Adding a material takes a ParticleType and a row here, in the same order. The
+// color tables and PARTICLE_TYPE_COUNT follow from those.
+constexpr std::array<Material, PARTICLE_TYPE_COUNT> MATERIALS = { {
+	// type, name, key, behaviour, color, cursor color, lifetime min/range, flammable, quenches fire
+	{ ParticleType::NONE, "", 0, Behaviour::STATIC, 0, 0, 0, 0, false, false },
+	{ ParticleType::SAND, "Sand", 1, Behaviour::POWDER,
+		Rgba(194, 178, 128, 255), Rgba(194, 178, 128, CURSOR_ALPHA), 0, 0, false, false },
+	{ ParticleType::WATER, "Water", 2, Behaviour::LIQUID,
+		Rgba(0, 105, 148, 255), Rgba(0, 105, 148, CURSOR_ALPHA), 0, 0, false, true },
+	{ ParticleType::WOOD, "Wood", 3, Behaviour::STATIC,
+		Rgba(111, 76, 30, 135), Rgba(111, 76, 30, CURSOR_ALPHA), 0, 0, true, false },
+	{ ParticleType::FIRE, "Fire", 4, Behaviour::FIRE,
+		Rgba(226, 88, 34, 255), Rgba(226, 88, 34, CURSOR_ALPHA), 200, 50, false, false },
+	{ ParticleType::SMOKE, "Smoke", 5, Behaviour::GAS,
+		Rgba(131, 131, 131, 255), Rgba(131, 131, 131, CURSOR_ALPHA), 100, 50, false, false },
+	{ ParticleType::STEAM, "Steam", 6, Behaviour::GAS,
+		Rgba(245, 245, 245, 255), Rgba(245, 245, 245, CURSOR_ALPHA), 100, 50, false, false },
+} };
 
-bool Particle::IsNone() {
-	return type == ParticleType::NONE;
+constexpr bool IsTableInTypeOrder() {
+	for (unsigned int i = 0; i < PARTICLE_TYPE_COUNT; i++) {
+		if ((unsigned int)MATERIALS[i].type != i) {
+			return false;
+		}
+	}
+	return true;
 }
+// Also catches missing rows, which are zeroed and so claim to be NONE
+static_assert(IsTableInTypeOrder(), "MATERIALS needs one row per ParticleType, in the same order");
 
-void Particle::ReassignTo(ParticleType type) {
-	this->type = type;
-	if (type == ParticleType::FIRE) {
-		lifetime = rand() % 50 + 200;
-	} else if (type == ParticleType::SMOKE || type == ParticleType::STEAM) {
-		lifetime = rand() % 50 + 100;
+constexpr std::array<uint32_t, PARTICLE_TYPE_COUNT> BuildColorTable(uint32_t Material::* color) {
+	std::array<uint32_t, PARTICLE_TYPE_COUNT> table = {};
+	for (unsigned int i = 0; i < PARTICLE_TYPE_COUNT; i++) {
+		table[i] = MATERIALS[i].*color;
 	}
-}
\ No newline at end of file
+	return table;
+}
+
+constexpr std::array<uint32_t, PARTICLE_TYPE_COUNT> PARTICLE_COLORS = BuildColorTable(&Material::color);
+constexpr std::array<uint32_t, PARTICLE_TYPE_COUNT> PARTICLE_CURSOR_COLORS = BuildColorTable(&Material::cursorColor);
+
+uint8_t GetInitialLifetime(ParticleType type, Random& random) {
+	const Material& material = GetMaterial(type);
+	if (material.lifetimeRange == 0) {
+		return material.lifetimeMin;
+	}
+	return random.NextBelow(material.lifetimeRange) + material.lifetimeMin;
+}
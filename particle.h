@@ -1,6 +1,13 @@
 #pragma once
 
-enum class ParticleType {
+#include <stdint.h>
+#include <array>
+
+#include "random.h"
+
+// Stored as one byte per cell in Simulation's type plane. Each type has a
+// row in MATERIALS, in the same order.
+enum class ParticleType : uint8_t {
 	NONE,
 	SAND,
 	WATER,
@@ -8,15 +15,62 @@ enum class ParticleType {
 	FIRE,
 	SMOKE,
 	STEAM,
+	// Not a type, new ones go above it
+	COUNT,
+};
+
+constexpr unsigned int PARTICLE_TYPE_COUNT = (unsigned int)ParticleType::COUNT;
+
+// How a material moves each tick, Simulation::UpdateParticle switches on this
+enum class Behaviour : uint8_t {
+	// Never moves on its own
+	STATIC,
+	// Falls, piling up diagonally
+	POWDER,
+	// Falls, then spreads sideways
+	LIQUID,
+	// Flows like a liquid while setting flammable neighbours alight
+	FIRE,
+	// Rises, tunnelling up through fluids
+	GAS,
 };
 
-class Particle {
-public:
-	ParticleType type = ParticleType::NONE;
-	int lifetime = 0;
-	bool updatedThisFrame = false;
+struct Material {
+	// Must match the material's row in MATERIALS
+	ParticleType type;
+	// Shown in the UI, next to the number key that selects it (0 for none)
+	const char* name;
+	unsigned int key;
+	Behaviour behaviour;
+	// RGBA colors of the particle and of the brush preview drawn over empty cells
+	uint32_t color;
+	uint32_t cursorColor;
+	// New particles live for lifetimeMin plus up to lifetimeRange - 1 ticks.
+	// Both are 0 for materials that never burn out or dissipate.
+	uint8_t lifetimeMin;
+	uint8_t lifetimeRange;
+	// Fire next to it may set it alight
+	bool flammable;
+	// Turns fire above it into steam, along with itself
+	bool quenchesFire;
+};
+
+extern const std::array<Material, PARTICLE_TYPE_COUNT> MATERIALS;
+
+// RGBA colors, indexed by ParticleType. Built from MATERIALS for lookups in tight loops.
+extern const std::array<uint32_t, PARTICLE_TYPE_COUNT> PARTICLE_COLORS;
+extern const std::array<uint32_t, PARTICLE_TYPE_COUNT> PARTICLE_CURSOR_COLORS;
+
+inline const Material& GetMaterial(ParticleType type) {
+	return MATERIALS[(uint8_t)type];
+}
+
+// Liquids, fire and gases, which rising gas can tunnel through
+inline bool IsFluid(ParticleType type) {
+	Behaviour behaviour = GetMaterial(type).behaviour;
+	return behaviour == Behaviour::LIQUID || behaviour == Behaviour::FIRE || behaviour == Behaviour::GAS;
+}
 
-	Particle();
-	bool IsNone();
-	void ReassignTo(ParticleType type);
-};
\ No newline at end of file
+// Number of ticks a freshly created particle of this type lives for,
+// or 0 for types that never burn out or dissipate.
+uint8_t GetInitialLifetime(ParticleType type, Random& random);
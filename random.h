@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Small, fast, seedable PRNG (xorshift64*). Cheap enough to create one per
+// chunk per tick, which keeps parallel updates free of shared random state.
+class Random {
+public:
+	Random(uint64_t seed) : state(Mix(seed) | 1) {}
+	// An independent stream derived from a seed, e.g. one per chunk per tick
+	Random(uint64_t seed, uint64_t stream) : state(Mix(seed ^ Mix(stream)) | 1) {}
+
+	uint64_t Next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+
+	// Uniform in [0, bound)
+	uint32_t NextBelow(uint32_t bound) {
+		return (uint32_t)(((Next() >> 32) * bound) >> 32);
+	}
+
+	bool NextBool() {
+		return Next() >> 63;
+	}
+
+	// splitmix64 finalizer, spreads nearby seeds across the whole state space
+	static uint64_t Mix(uint64_t x) {
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+private:
+	uint64_t state;
+};
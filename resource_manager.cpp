@@ -1,34 +1,267 @@
 #include "resource_manager.h"
+#include "fnv.h"
+#include "mapped_file.h"
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <stdexcept>
+#include <vector>
 
-std::map<std::string, Texture2D> ResourceManager::textures;
-std::map<std::string, Shader> ResourceManager::shaders;
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
+// Program binary cache files, one per set of sources and driver. Layout, native endian:
+//   "PBIN", version, key, binary format, binary length, binary
+constexpr char PROGRAM_CACHE_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
 
-Shader ResourceManager::LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name) {
-  shaders[name] = LoadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
-  return shaders[name];
+// binaries only work on the driver that made them, so the driver is part of the key
+uint64_t ProgramCacheKey(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+    const char* value = (const char*)glGetString(name);
+    if (value) {
+      hash = HashBytes(value, strlen(value) + 1, hash);
+    }
+  }
+  for (const std::string* code : { &vertexCode, &fragmentCode, &geometryCode }) {
+    uint64_t length = code->size();
+    hash = HashBytes(&length, sizeof(length), hash);
+    hash = HashBytes(code->data(), code->size(), hash);
+  }
+  return hash;
+}
+
+bool ProgramBinariesSupported() {
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+  // the entry points are only loaded on GL 4.1 or with ARB_get_program_binary
+  if (!glProgramParameteri || !glProgramBinary || !glGetProgramBinary) {
+    return false;
+  }
+  // drivers may expose the entry points yet support no formats, llvmpipe among them on older Mesa
+  int formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+#else
+  return false;
+#endif
+}
+
+bool LoadCachedProgram(const std::string& path, uint64_t key, Shader* shader) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(PROGRAM_CACHE_MAGIC)] = {};
+  uint32_t version = 0, format = 0, length = 0;
+  uint64_t cachedKey = 0;
+  file.read(magic, sizeof(magic));
+  file.read((char*)&version, sizeof(version));
+  file.read((char*)&cachedKey, sizeof(cachedKey));
+  file.read((char*)&format, sizeof(format));
+  file.read((char*)&length, sizeof(length));
+  if (!file || memcmp(magic, PROGRAM_CACHE_MAGIC, sizeof(magic)) != 0 || version != PROGRAM_CACHE_VERSION || cachedKey != key) {
+    return false;
+  }
+  std::vector<char> binary(length);
+  if (!file.read(binary.data(), length)) {
+    return false;
+  }
+  return shader->LoadBinary(format, binary);
+}
+
+void SaveCachedProgram(const std::string& path, uint64_t key, const Shader& shader) {
+  unsigned int format;
+  std::vector<char> binary;
+  if (!shader.GetBinary(&format, &binary)) {
+    return;
+  }
+  uint32_t length = (uint32_t)binary.size();
+  bool written = WriteFileAtomically(path, [&](std::ofstream& file) {
+    file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+    file.write((const char*)&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+    file.write((const char*)&key, sizeof(key));
+    file.write((const char*)&format, sizeof(format));
+    file.write((const char*)&length, sizeof(length));
+    file.write(binary.data(), length);
+  });
+  if (!written) {
+    std::cout << "Failed to write program cache: " << path << std::endl;
+  }
 }
 
-Shader ResourceManager::GetShader(std::string name) {
-  return shaders[name];
+std::deque<Shader> ResourceManager::shaders;
+std::deque<Texture2D> ResourceManager::textures;
+std::unordered_map<std::string, ShaderHandle> ResourceManager::shaderHandles;
+std::unordered_map<std::string, TextureHandle> ResourceManager::textureHandles;
+std::string ResourceManager::programCacheDirectory;
+std::deque<ResourceManager::ShaderFiles> ResourceManager::shaderFiles;
+int ResourceManager::shaderWatchFd = -1;
+std::vector<ResourceManager::WatchedFile> ResourceManager::watchedFiles;
+
+
+ShaderHandle ResourceManager::LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, const std::string& name) {
+  Shader shader;
+  LoadShaderFromFile(vShaderFile, fShaderFile, gShaderFile, &shader);
+  ShaderFiles files = { vShaderFile, fShaderFile, gShaderFile ? gShaderFile : "" };
+  auto iter = shaderHandles.find(name);
+  if (iter != shaderHandles.end()) {
+    glDeleteProgram(shaders[iter->second].id);
+    shaders[iter->second] = shader;
+    shaderFiles[iter->second] = files;
+    WatchShader(iter->second);
+    return iter->second;
+  }
+  shaders.push_back(shader);
+  shaderFiles.push_back(files);
+  ShaderHandle handle = (ShaderHandle)shaders.size() - 1;
+  shaderHandles.emplace(name, handle);
+  WatchShader(handle);
+  return handle;
+}
+
+const Shader& ResourceManager::GetShader(ShaderHandle handle) {
+  if (handle >= shaders.size()) {
+    throw std::out_of_range("No shader loaded with handle " + std::to_string(handle));
+  }
+  return shaders[handle];
 }
 
-Texture2D ResourceManager::GetTexture(std::string name) {
-  return textures[name];
+ShaderHandle ResourceManager::FindShader(const std::string& name) {
+  auto iter = shaderHandles.find(name);
+  if (iter == shaderHandles.end()) {
+    throw std::out_of_range("No shader loaded with name " + name);
+  }
+  return iter->second;
+}
+
+const Texture2D& ResourceManager::GetTexture(TextureHandle handle) {
+  if (handle >= textures.size()) {
+    throw std::out_of_range("No texture loaded with handle " + std::to_string(handle));
+  }
+  return textures[handle];
+}
+
+TextureHandle ResourceManager::FindTexture(const std::string& name) {
+  auto iter = textureHandles.find(name);
+  if (iter == textureHandles.end()) {
+    throw std::out_of_range("No texture loaded with name " + name);
+  }
+  return iter->second;
 }
 
 void ResourceManager::Clear() {
-  for (auto iter : shaders)
-    glDeleteProgram(iter.second.id);
-  for (auto iter : textures)
-    glDeleteTextures(1, &iter.second.id);
+  for (const Shader& shader : shaders)
+    glDeleteProgram(shader.id);
+  for (const Texture2D& texture : textures)
+    glDeleteTextures(1, &texture.id);
+  shaders.clear();
+  textures.clear();
+  shaderHandles.clear();
+  textureHandles.clear();
+  shaderFiles.clear();
+  watchedFiles.clear();
+#ifdef __linux__
+  if (shaderWatchFd >= 0) {
+    close(shaderWatchFd);
+    shaderWatchFd = -1;
+  }
+#endif
+}
+
+void ResourceManager::SetProgramCacheDirectory(const std::string& directory) {
+  programCacheDirectory = directory;
+}
+
+void ResourceManager::WatchShaderFiles() {
+#ifdef __linux__
+  if (shaderWatchFd >= 0) {
+    return;
+  }
+  shaderWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (shaderWatchFd < 0) {
+    std::cout << "Failed to start watching shader files" << std::endl;
+    return;
+  }
+  for (ShaderHandle handle = 0; handle < shaders.size(); handle++) {
+    WatchShader(handle);
+  }
+#else
+  std::cout << "Watching shader files is only supported on Linux" << std::endl;
+#endif
+}
+
+void ResourceManager::WatchShader(ShaderHandle handle) {
+#ifdef __linux__
+  if (shaderWatchFd < 0) {
+    return;
+  }
+  const ShaderFiles& files = shaderFiles[handle];
+  for (const std::string* path : { &files.vertex, &files.fragment, &files.geometry }) {
+    if (path->empty()) {
+      continue;
+    }
+    // editors often save by replacing the file, which would end a watch on the file itself,
+    // so the directory is watched instead. Watching a directory twice gives the same watch
+    size_t slash = path->find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path->substr(0, slash + 1);
+    int watch = inotify_add_watch(shaderWatchFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+      std::cout << "Failed to watch shader directory: " << directory << std::endl;
+      continue;
+    }
+    watchedFiles.push_back({ watch, path->substr(slash == std::string::npos ? 0 : slash + 1), handle });
+  }
+#endif
 }
 
-Shader ResourceManager::LoadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile) {
+void ResourceManager::ReloadChangedShaders() {
+#ifdef __linux__
+  if (shaderWatchFd < 0) {
+    return;
+  }
+  alignas(inotify_event) char events[4096];
+  ssize_t length = read(shaderWatchFd, events, sizeof(events));
+  // the fd is non-blocking, so most frames stop here with EAGAIN
+  if (length <= 0) {
+    return;
+  }
+  // several events for the same save only reload the shader once
+  std::vector<bool> changed(shaders.size(), false);
+  do {
+    for (char* cursor = events; cursor < events + length; cursor += sizeof(inotify_event) + ((inotify_event*)cursor)->len) {
+      const inotify_event* event = (const inotify_event*)cursor;
+      for (const WatchedFile& file : watchedFiles) {
+        if (event->len > 0 && file.watch == event->wd && file.name == event->name) {
+          changed[file.shader] = true;
+        }
+      }
+    }
+  } while ((length = read(shaderWatchFd, events, sizeof(events))) > 0);
+
+  for (ShaderHandle handle = 0; handle < shaders.size(); handle++) {
+    if (!changed[handle]) {
+      continue;
+    }
+    const ShaderFiles& files = shaderFiles[handle];
+    Shader shader;
+    if (!LoadShaderFromFile(files.vertex.c_str(), files.fragment.c_str(), files.geometry.empty() ? nullptr : files.geometry.c_str(), &shader)) {
+      std::cout << "Keeping the previous program for " << files.fragment << std::endl;
+      glDeleteProgram(shader.id);
+      continue;
+    }
+    // uniforms set once at load time, like samplers and palettes, carry over to the new program
+    shader.CopyUniformsFrom(shaders[handle]);
+    glDeleteProgram(shaders[handle].id);
+    shaders[handle] = shader;
+    std::cout << "Reloaded " << files.vertex << " and " << files.fragment << std::endl;
+  }
+#endif
+}
+
+bool ResourceManager::LoadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, Shader* shader) {
   std::string vertexCode;
   std::string fragmentCode;
   std::string geometryCode;
@@ -59,7 +292,21 @@ Shader ResourceManager::LoadShaderFromFile(const char* vShaderFile, const char*
   const char* fShaderCode = fragmentCode.c_str();
   const char* gShaderCode = geometryCode.c_str();
 
-  Shader shader;
-  shader.Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
-  return shader;
+  bool useCache = !programCacheDirectory.empty() && ProgramBinariesSupported();
+  std::string cachePath;
+  uint64_t key = 0;
+  if (useCache) {
+    key = ProgramCacheKey(vertexCode, fragmentCode, geometryCode);
+    char cacheName[32];
+    std::snprintf(cacheName, sizeof(cacheName), "%016llx.program", (unsigned long long)key);
+    cachePath = programCacheDirectory + cacheName;
+    if (LoadCachedProgram(cachePath, key, shader)) {
+      return true;
+    }
+  }
+  bool compiled = shader->Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr, useCache);
+  if (useCache && compiled) {
+    SaveCachedProgram(cachePath, key, *shader);
+  }
+  return compiled;
 }
\ No newline at end of file
@@ -1,25 +1,64 @@
 #pragma once
-#include <map>
+#include <deque>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 
 #include "texture.h"
 #include "shader.h"
 
+// handles index straight into ResourceManager's storage, resolve them once at load
+// time and use them for every lookup after that
+typedef unsigned int ShaderHandle;
+typedef unsigned int TextureHandle;
 
 class ResourceManager {
 public:
-  static std::map<std::string, Shader> shaders;
-  static std::map<std::string, Texture2D> textures;
-
-  static Shader LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name);
-  static Shader GetShader(std::string name);
-  static Texture2D LoadTexture(const char* file, bool alpha, std::string name);
-  static Texture2D GetTexture(std::string name);
+  // loading a name that is already loaded replaces it in place and keeps its handle
+  static ShaderHandle LoadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, const std::string& name);
+  // references stay valid until Clear, a handle that was never loaded throws std::out_of_range
+  static const Shader& GetShader(ShaderHandle handle);
+  // throws std::out_of_range if no shader was loaded under name
+  static ShaderHandle FindShader(const std::string& name);
+  static TextureHandle LoadTexture(const char* file, bool alpha, const std::string& name);
+  static const Texture2D& GetTexture(TextureHandle handle);
+  static TextureHandle FindTexture(const std::string& name);
+  // deletes every resource, invalidating all handles
   static void Clear();
+  // keeps linked shader programs as driver binaries in directory, so later launches with the
+  // same sources and driver skip compiling. Off until a directory is set
+  static void SetProgramCacheDirectory(const std::string& directory);
+  // starts watching the source files of every shader, loaded now or later, for changes (Linux only)
+  static void WatchShaderFiles();
+  // recompiles shaders whose files changed since the last call and swaps them in behind their
+  // handles. A shader that fails to compile keeps its old program. Call on the GL thread
+  static void ReloadChangedShaders();
 private:
   ResourceManager() {}
-  static Shader LoadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile = nullptr);
+  struct ShaderFiles {
+    std::string vertex, fragment, geometry;
+  };
+  // a shader source file as seen by inotify, a directory watch and a file name in it
+  struct WatchedFile {
+    int watch;
+    std::string name;
+    ShaderHandle shader;
+  };
+  // deques so growing never moves the resources references were handed out to
+  static std::deque<Shader> shaders;
+  static std::deque<Texture2D> textures;
+  static std::unordered_map<std::string, ShaderHandle> shaderHandles;
+  static std::unordered_map<std::string, TextureHandle> textureHandles;
+  static std::string programCacheDirectory;
+  static std::deque<ShaderFiles> shaderFiles;
+  static int shaderWatchFd;
+  static std::vector<WatchedFile> watchedFiles;
+
+  static void WatchShader(ShaderHandle handle);
+
+  // returns false if the shader didn't compile, in which case shader is unusable
+  static bool LoadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, Shader* shader);
   static Texture2D LoadTextureFromFile(const char* file, bool alpha);
-};
\ No newline at end of file
+};
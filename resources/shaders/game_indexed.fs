@@ -0,0 +1,25 @@
+#version 330 core
+// Colors the raw particle type plane, see GameRenderer's INDEXED mode
+in vec2 TexCoords;
+out vec4 color;
+
+const int MAX_PALETTE_SIZE = 64;
+
+uniform usampler2D types;
+uniform vec4 palette[MAX_PALETTE_SIZE];
+uniform vec4 cursorColor;
+// xMin, yMin, xMax, yMax in cells, inclusive
+uniform vec4 cursorRect;
+
+void main() {
+	ivec2 size = textureSize(types, 0);
+	ivec2 cell = min(ivec2(TexCoords * vec2(size)), size - 1);
+	uint type = texelFetch(types, cell, 0).r;
+
+	color = palette[min(int(type), MAX_PALETTE_SIZE - 1)];
+	// The brush preview only shows over empty cells
+	vec2 position = vec2(cell);
+	if (type == 0u && all(greaterThanEqual(position, cursorRect.xy)) && all(lessThanEqual(position, cursorRect.zw))) {
+		color = cursorColor;
+	}
+}
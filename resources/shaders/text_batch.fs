@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 TexCoords;
+in vec3 TextColor;
+out vec4 color;
+
+// The glyph atlas, coverage in the red channel
+uniform sampler2D text;
+
+void main() {
+	color = vec4(TextColor, texture(text, TexCoords).r);
+}
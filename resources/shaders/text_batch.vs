@@ -0,0 +1,15 @@
+#version 330 core
+// Batched text, see TextRenderer::Flush
+layout (location = 0) in vec4 vertex; // <vec2 position, vec2 texCoords>
+layout (location = 1) in vec3 vertexColor;
+
+out vec2 TexCoords;
+out vec3 TextColor;
+
+uniform mat4 projection;
+
+void main() {
+	TexCoords = vertex.zw;
+	TextColor = vertexColor;
+	gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 TexCoords;
+in vec3 TextColor;
+out vec4 color;
+
+// The glyph atlas as signed distance fields, 0.5 on the outline and rising inwards
+uniform sampler2D text;
+
+const float ON_EDGE = 128.0 / 255.0;
+
+void main() {
+	float distance = texture(text, TexCoords).r;
+	// Antialias over about one screen pixel, whatever scale the text is drawn at. Where the
+	// field is flat fwidth is 0, and smoothstep is undefined for equal edges.
+	float smoothing = max(fwidth(distance) * 0.75, 1e-4);
+	color = vec4(TextColor, smoothstep(ON_EDGE - smoothing, ON_EDGE + smoothing, distance));
+}
@@ -2,29 +2,30 @@
 
 #include <iostream>
 
-Shader& Shader::Use() {
+const Shader& Shader::Use() const {
   glUseProgram(this->id);
   return *this;
 }
 
-void Shader::Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource) {
+bool Shader::Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource, bool retrievable) {
   unsigned int sVertex, sFragment, gShader;
+  bool success = true;
   // vertex Shader
   sVertex = glCreateShader(GL_VERTEX_SHADER);
   glShaderSource(sVertex, 1, &vertexSource, NULL);
   glCompileShader(sVertex);
-  checkCompileErrors(sVertex, "VERTEX");
+  success &= checkCompileErrors(sVertex, "VERTEX");
   // fragment Shader
   sFragment = glCreateShader(GL_FRAGMENT_SHADER);
   glShaderSource(sFragment, 1, &fragmentSource, NULL);
   glCompileShader(sFragment);
-  checkCompileErrors(sFragment, "FRAGMENT");
+  success &= checkCompileErrors(sFragment, "FRAGMENT");
   // if geometry shader source code is given, also compile geometry shader
   if (geometrySource != nullptr) {
     gShader = glCreateShader(GL_GEOMETRY_SHADER);
     glShaderSource(gShader, 1, &geometrySource, NULL);
     glCompileShader(gShader);
-    checkCompileErrors(gShader, "GEOMETRY");
+    success &= checkCompileErrors(gShader, "GEOMETRY");
   }
   // shader program
   this->id = glCreateProgram();
@@ -32,63 +33,176 @@ void Shader::Compile(const char* vertexSource, const char* fragmentSource, const
   glAttachShader(this->id, sFragment);
   if (geometrySource != nullptr)
     glAttachShader(this->id, gShader);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+  // lets the driver keep what GetBinary needs
+  if (retrievable)
+    glProgramParameteri(this->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
   glLinkProgram(this->id);
-  checkCompileErrors(this->id, "PROGRAM");
+  success &= checkCompileErrors(this->id, "PROGRAM");
+  cacheUniformLocations();
   // delete the shaders as they're linked into our program now and no longer necessary
   glDeleteShader(sVertex);
   glDeleteShader(sFragment);
   if (geometrySource != nullptr)
     glDeleteShader(gShader);
+  return success;
 }
 
-void Shader::SetFloat(const char* name, float value, bool useShader) {
+bool Shader::LoadBinary(unsigned int format, const std::vector<char>& binary) {
+#ifdef GL_PROGRAM_BINARY_LENGTH
+  this->id = glCreateProgram();
+  glProgramBinary(this->id, format, binary.data(), (GLsizei)binary.size());
+  int success;
+  glGetProgramiv(this->id, GL_LINK_STATUS, &success);
+  if (!success) {
+    // a different driver build or GPU, the caller compiles from source instead
+    glDeleteProgram(this->id);
+    this->id = 0;
+    return false;
+  }
+  cacheUniformLocations();
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Shader::GetBinary(unsigned int* format, std::vector<char>* binary) const {
+#ifdef GL_PROGRAM_BINARY_LENGTH
+  int length = 0;
+  glGetProgramiv(this->id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return false;
+  }
+  binary->resize(length);
+  GLenum binaryFormat;
+  glGetProgramBinary(this->id, length, &length, &binaryFormat, binary->data());
+  binary->resize(length);
+  *format = binaryFormat;
+  return length > 0;
+#else
+  return false;
+#endif
+}
+
+void Shader::SetFloat(const char* name, float value, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform1f(glGetUniformLocation(this->id, name), value);
+  glUniform1f(this->GetUniformLocation(name), value);
 }
-void Shader::SetInteger(const char* name, int value, bool useShader) {
+void Shader::SetInteger(const char* name, int value, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform1i(glGetUniformLocation(this->id, name), value);
+  glUniform1i(this->GetUniformLocation(name), value);
 }
-void Shader::SetVector2f(const char* name, float x, float y, bool useShader) {
+void Shader::SetVector2f(const char* name, float x, float y, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform2f(glGetUniformLocation(this->id, name), x, y);
+  glUniform2f(this->GetUniformLocation(name), x, y);
 }
-void Shader::SetVector2f(const char* name, const glm::vec2& value, bool useShader) {
+void Shader::SetVector2f(const char* name, const glm::vec2& value, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform2f(glGetUniformLocation(this->id, name), value.x, value.y);
+  glUniform2f(this->GetUniformLocation(name), value.x, value.y);
 }
-void Shader::SetVector3f(const char* name, float x, float y, float z, bool useShader) {
+void Shader::SetVector3f(const char* name, float x, float y, float z, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform3f(glGetUniformLocation(this->id, name), x, y, z);
+  glUniform3f(this->GetUniformLocation(name), x, y, z);
 }
-void Shader::SetVector3f(const char* name, const glm::vec3& value, bool useShader) {
+void Shader::SetVector3f(const char* name, const glm::vec3& value, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform3f(glGetUniformLocation(this->id, name), value.x, value.y, value.z);
+  glUniform3f(this->GetUniformLocation(name), value.x, value.y, value.z);
 }
-void Shader::SetVector4f(const char* name, float x, float y, float z, float w, bool useShader) {
+void Shader::SetVector4f(const char* name, float x, float y, float z, float w, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform4f(glGetUniformLocation(this->id, name), x, y, z, w);
+  glUniform4f(this->GetUniformLocation(name), x, y, z, w);
 }
-void Shader::SetVector4f(const char* name, const glm::vec4& value, bool useShader) {
+void Shader::SetVector4f(const char* name, const glm::vec4& value, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniform4f(glGetUniformLocation(this->id, name), value.x, value.y, value.z, value.w);
+  glUniform4f(this->GetUniformLocation(name), value.x, value.y, value.z, value.w);
 }
-void Shader::SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader) {
+void Shader::SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader) const {
   if (useShader)
     this->Use();
-  glUniformMatrix4fv(glGetUniformLocation(this->id, name), 1, false, glm::value_ptr(matrix));
+  glUniformMatrix4fv(this->GetUniformLocation(name), 1, false, glm::value_ptr(matrix));
+}
+
+int Shader::GetUniformLocation(const char* name) const {
+  auto iter = this->uniformLocations.find(name);
+  return iter != this->uniformLocations.end() ? iter->second : -1;
 }
 
+void Shader::CopyUniformsFrom(const Shader& other) const {
+  this->Use();
+  int count = 0;
+  char name[256];
+  glGetProgramiv(other.id, GL_ACTIVE_UNIFORMS, &count);
+  for (int i = 0; i < count; i++) {
+    int length = 0, size = 0;
+    GLenum type;
+    glGetActiveUniform(other.id, i, sizeof(name), &length, &size, &type, name);
+    std::string base(name, length);
+    base = base.substr(0, base.find('['));
+    for (int element = 0; element < size; element++) {
+      std::string elementName = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+      int from = other.GetUniformLocation(elementName.c_str());
+      int to = this->GetUniformLocation(elementName.c_str());
+      if (from < 0 || to < 0) {
+        continue;
+      }
+      float floats[16];
+      int ints[4];
+      switch (type) {
+      case GL_FLOAT: glGetUniformfv(other.id, from, floats); glUniform1fv(to, 1, floats); break;
+      case GL_FLOAT_VEC2: glGetUniformfv(other.id, from, floats); glUniform2fv(to, 1, floats); break;
+      case GL_FLOAT_VEC3: glGetUniformfv(other.id, from, floats); glUniform3fv(to, 1, floats); break;
+      case GL_FLOAT_VEC4: glGetUniformfv(other.id, from, floats); glUniform4fv(to, 1, floats); break;
+      case GL_FLOAT_MAT4: glGetUniformfv(other.id, from, floats); glUniformMatrix4fv(to, 1, false, floats); break;
+      // samplers hold the texture unit they read from
+      case GL_INT: case GL_BOOL: case GL_SAMPLER_2D: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+        glGetUniformiv(other.id, from, ints); glUniform1iv(to, 1, ints); break;
+      default: break; // not used by any of our shaders
+      }
+    }
+  }
+}
+
+void Shader::cacheUniformLocations() {
+  this->uniformLocations.clear();
+  int count = 0, maxNameLength = 0;
+  glGetProgramiv(this->id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(this->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+  std::string name(maxNameLength, '\0');
+  for (int i = 0; i < count; i++) {
+    int length = 0, size = 0;
+    GLenum type;
+    glGetActiveUniform(this->id, i, maxNameLength, &length, &size, &type, &name[0]);
+    std::string uniform(name.data(), length);
+    int location = glGetUniformLocation(this->id, uniform.c_str());
+    if (location < 0) {
+      continue; // uniform block members have no location
+    }
+    // arrays are reported as "name[0]", register every element and the bare name
+    size_t bracket = uniform.find('[');
+    if (bracket == std::string::npos) {
+      this->uniformLocations[uniform] = location;
+      continue;
+    }
+    std::string base = uniform.substr(0, bracket);
+    this->uniformLocations[base] = location;
+    for (int element = 0; element < size; element++) {
+      std::string elementName = base + "[" + std::to_string(element) + "]";
+      this->uniformLocations[elementName] = glGetUniformLocation(this->id, elementName.c_str());
+    }
+  }
+}
 
-void Shader::checkCompileErrors(unsigned int object, std::string type) {
+bool Shader::checkCompileErrors(unsigned int object, std::string type) {
   int success;
   char infoLog[1024];
   if (type != "PROGRAM") {
@@ -108,4 +222,5 @@ void Shader::checkCompileErrors(unsigned int object, std::string type) {
         << std::endl;
     }
   }
+  return success;
 }
\ No newline at end of file
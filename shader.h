@@ -1,6 +1,8 @@
 #pragma once
 
+#include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -13,20 +15,34 @@ public:
   // constructor
   Shader() {}
   // sets the current shader as active
-  Shader& Use();
-  // compiles the shader from given source code
-  void    Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr); // note: geometry source code is optional 
+  const Shader& Use() const;
+  // compiles the shader from given source code, returns false if compiling or linking failed.
+  // retrievable asks the driver to keep what GetBinary needs, only pass true where program binaries are supported
+  bool    Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr, bool retrievable = false); // note: geometry source code is optional 
+  // creates the program from a binary saved by GetBinary, returns false if the driver rejects it
+  bool    LoadBinary(unsigned int format, const std::vector<char>& binary);
+  // gets the linked program in the driver's own format, returns false if the driver can't provide one
+  bool    GetBinary(unsigned int* format, std::vector<char>* binary) const;
+  // sets every uniform this program shares with other to the value it has in other, so a
+  // recompiled program picks up where the old one was. Makes this shader the active one
+  void    CopyUniformsFrom(const Shader& other) const;
+  // location of a uniform from the cache filled in by Compile, -1 (ignored by glUniform*) if the program has none by that name
+  int     GetUniformLocation(const char* name) const;
   // utility functions
-  void    SetFloat(const char* name, float value, bool useShader = false);
-  void    SetInteger(const char* name, int value, bool useShader = false);
-  void    SetVector2f(const char* name, float x, float y, bool useShader = false);
-  void    SetVector2f(const char* name, const glm::vec2& value, bool useShader = false);
-  void    SetVector3f(const char* name, float x, float y, float z, bool useShader = false);
-  void    SetVector3f(const char* name, const glm::vec3& value, bool useShader = false);
-  void    SetVector4f(const char* name, float x, float y, float z, float w, bool useShader = false);
-  void    SetVector4f(const char* name, const glm::vec4& value, bool useShader = false);
-  void    SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader = false);
+  void    SetFloat(const char* name, float value, bool useShader = false) const;
+  void    SetInteger(const char* name, int value, bool useShader = false) const;
+  void    SetVector2f(const char* name, float x, float y, bool useShader = false) const;
+  void    SetVector2f(const char* name, const glm::vec2& value, bool useShader = false) const;
+  void    SetVector3f(const char* name, float x, float y, float z, bool useShader = false) const;
+  void    SetVector3f(const char* name, const glm::vec3& value, bool useShader = false) const;
+  void    SetVector4f(const char* name, float x, float y, float z, float w, bool useShader = false) const;
+  void    SetVector4f(const char* name, const glm::vec4& value, bool useShader = false) const;
+  void    SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader = false) const;
 private:
+  // every active uniform's location, looked up by name without allocating
+  std::map<std::string, int, std::less<>> uniformLocations;
   // checks if compilation or linking failed and if so, print the error logs
-  void    checkCompileErrors(unsigned int object, std::string type);
+  bool    checkCompileErrors(unsigned int object, std::string type);
+  // asks the driver for every active uniform's location once, so setters never have to
+  void    cacheUniformLocations();
 };
\ No newline at end of file
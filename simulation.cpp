@@ -1,173 +1,411 @@
 #include <assert.h>
 #include <stdint.h>
-#include <stdlib.h>
 
+#include <algorithm>
+
+#include "color_kernel.h"
+#include "fnv.h"
 #include "simulation.h"
-#include "text_renderer.h"
 
-// RGBA colors
-constexpr uint32_t SAND_COLOR = 194 + (178 << 8) + (128 << 16) + (255 << 24); 
-const glm::vec3 SAND_COLOR_VEC = glm::vec3(0.76f, 0.7f, 0.5f);
-constexpr uint32_t SAND_COLOR_CURSOR = 194 + (178 << 8) + (128 << 16) + (128 << 24);
+// Bitmap words are a reach wide and aligned to it, so chunks updating at the same time never share one
+constexpr unsigned int OCCUPANCY_WORD_BITS = 16;
+static_assert(CHUNK_REACH % OCCUPANCY_WORD_BITS == 0 && CHUNK_SIZE % OCCUPANCY_WORD_BITS == 0,
+	"occupancy words must not straddle the cells of two chunks updated in parallel");
 
-constexpr uint32_t WATER_COLOR = 0 + (105 << 8) + (148 << 16) + (255 << 24); 
-const glm::vec3 WATER_COLOR_VEC = glm::vec3(0, 0.41f, 0.58f);
-constexpr uint32_t WATER_COLOR_CURSOR = 0 + (105 << 8) + (148 << 16) + (128 << 24);
+// updateStamp cycles through [0, STAMP_PERIOD), STAMP_NEVER is never current
+constexpr uint8_t STAMP_PERIOD = 255;
+constexpr uint8_t STAMP_NEVER = 255;
 
-constexpr uint32_t WOOD_COLOR = 111 + (76 << 8) + (30 << 16) + (135 << 24); 
-const glm::vec3 WOOD_COLOR_VEC = glm::vec3(0.44f, 0.30f, 0.12f);
-constexpr uint32_t WOOD_COLOR_CURSOR = 111 + (76 << 8) + (30 << 16) + (128 << 24);
+bool ShouldCatchFire(Random& random) {
+	return random.NextBelow(70) == 0;
+}
 
-constexpr uint32_t FIRE_COLOR = 226 + (88 << 8) + (34 << 16) + (255 << 24); 
-const glm::vec3 FIRE_COLOR_VEC = glm::vec3(0.89f, 0.35f, 0.13f);
-constexpr uint32_t FIRE_COLOR_CURSOR = 226 + (88 << 8) + (34 << 16) + (128 << 24);
+Simulation::Simulation(unsigned int width, unsigned int height, unsigned int threadCount, uint64_t seed) :
+	width(width), height(height),
+	types(width * height, ParticleType::NONE),
+	lifetimes(width * height, 0),
+	updateStamps(width * height, STAMP_NEVER),
+	bitmapStride((width + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS),
+	occupancy(bitmapStride * height, 0),
+	powder(bitmapStride * height, 0),
+	sleeping(bitmapStride * height, 0),
+	chunksWide((width + CHUNK_SIZE - 1) / CHUNK_SIZE),
+	chunksHigh((height + CHUNK_SIZE - 1) / CHUNK_SIZE),
+	chunks(chunksWide * chunksHigh),
+	workers(new WorkerPool(std::max(threadCount, 1u))),
+	seed(seed),
+	random(seed) {}
 
-constexpr uint32_t SMOKE_COLOR = 131 + (131 << 8) + (131 << 16) + (255 << 24);
-const glm::vec3 SMOKE_COLOR_VEC = glm::vec3(0.51f, 0.51f, 0.51f);
-constexpr uint32_t SMOKE_COLOR_CURSOR = 131 + (131 << 8) + (131 << 16) + (128 << 24);
+void Simulation::ProcessInput() {
+	for (const Material& material : MATERIALS) {
+		if (material.key != 0 && material.key == input.lastNumKeyPressed) {
+			typeSelected = material.type;
+		}
+	}
 
-constexpr uint32_t STEAM_COLOR = 245 + (245 << 8) + (245 << 16) + (255 << 24);
-const glm::vec3 STEAM_COLOR_VEC = glm::vec3(0.96f, 0.96f, 0.96f);
-constexpr uint32_t STEAM_COLOR_CURSOR = 245 + (245 << 8) + (245 << 16) + (128 << 24);
+	if (input.mouseHeld) {
+		TryCreateInRegion(typeSelected, input.mouseX, input.mouseY, input.brushSize, input.brushSize);
+	}
+}
 
-TextRenderer* text;
+void Simulation::Update() {
+	tick++;
+	updateStamp++;
+	if (updateStamp == STAMP_PERIOD) {
+		updateStamp = 0;
+		std::fill(updateStamps.begin(), updateStamps.end(), STAMP_NEVER);
+	}
+	for (Chunk& chunk : chunks) {
+		chunk.current.CopyFrom(chunk.next);
+		chunk.next.Clear();
+	}
 
-bool ShouldCatchFire() {
-	return rand() % 70 == 0;
+	bool leftToRight = random.NextBool();
+	// Four checkerboard passes, bottom-left chunk of each 2x2 block first. Chunks in a pass
+	// are a chunk apart and updates stay within CHUNK_REACH, so they can run in parallel.
+	for (unsigned int phase = 0; phase < 4; phase++) {
+		phaseChunks.clear();
+		for (unsigned int cy = phase / 2; cy < chunksHigh; cy += 2) {
+			for (unsigned int cx = phase % 2; cx < chunksWide; cx += 2) {
+				unsigned int chunkIndex = cx + cy * chunksWide;
+				if (!chunks[chunkIndex].current.IsEmpty()) {
+					phaseChunks.push_back(chunkIndex);
+				}
+			}
+		}
+		workers->Run((unsigned int)phaseChunks.size(), [this, leftToRight](unsigned int i) {
+			UpdateChunk(phaseChunks[i], leftToRight);
+		});
+	}
 }
 
-Simulation::Simulation(unsigned int width, unsigned int height) : width(width), height(height) {
-	particles = new Particle[width * height];
+void Simulation::Render(void* screenBuffer) {
+	RenderRect({ 0, 0, width, height }, (uint32_t*)screenBuffer, width);
 }
 
-void Simulation::Init() {
-	text = new TextRenderer(this->width, this->height);
-	text->Load("resources/fonts/LiberationMono-Regular.ttf", 24);
+void Simulation::RenderRect(const CellRect& rect, uint32_t* pixels, unsigned int stride) {
+	if (rect.width == 0 || rect.height == 0) {
+		return;
+	}
+	for (unsigned int y = rect.y; y < rect.y + rect.height; y++) {
+		ColorizeRow(&types[GetIndex(rect.x, y)], pixels + (y - rect.y) * stride, rect.width);
+	}
+
+	// The brush preview only covers a few rows, so it's drawn over them afterwards
+	// instead of being tested for in every cell
+	uint32_t cursorColor = PARTICLE_CURSOR_COLORS[(uint8_t)typeSelected];
+	unsigned int xMouseMin, yMouseMin, xMouseMax, yMouseMax;
+	GetCursorRect(&xMouseMin, &yMouseMin, &xMouseMax, &yMouseMax);
+	unsigned int xMin = std::max(xMouseMin, rect.x), xMax = std::min(xMouseMax, rect.x + rect.width - 1);
+	unsigned int yMin = std::max(yMouseMin, rect.y), yMax = std::min(yMouseMax, rect.y + rect.height - 1);
+	for (unsigned int y = yMin; y <= yMax && xMin <= xMax; y++) {
+		uint32_t* pixelData = pixels + (y - rect.y) * stride;
+		for (unsigned int x = xMin; x <= xMax; x++) {
+			if (types[GetIndex(x, y)] == ParticleType::NONE) {
+				pixelData[x - rect.x] = cursorColor;
+			}
+		}
+	}
 }
 
-void Simulation::ProcessInput() {
-	if (lastNumKeyPressed == 1) {
-		typeSelected = ParticleType::SAND;
-	} else if (lastNumKeyPressed == 2) {
-		typeSelected = ParticleType::WATER;
-	} else if (lastNumKeyPressed == 3) {
-		typeSelected = ParticleType::WOOD;
-	} else if (lastNumKeyPressed == 4) {
-		typeSelected = ParticleType::FIRE;
-	} else if (lastNumKeyPressed == 5) {
-		typeSelected = ParticleType::SMOKE;
-	} else if (lastNumKeyPressed == 6) {
-		typeSelected = ParticleType::STEAM;
+void Simulation::TakeDamage(std::vector<CellRect>* rects) {
+	rects->clear();
+	unsigned int damagedCells = 0;
+	for (unsigned int cy = 0; cy < chunksHigh; cy++) {
+		// Damage in neighbouring chunks of a row is merged into one rect
+		DirtyRect merged;
+		for (unsigned int cx = 0; cx <= chunksWide; cx++) {
+			DirtyRect* damage = cx < chunksWide ? &chunks[cx + cy * chunksWide].damage : nullptr;
+			bool extendsMerged = damage && !damage->IsEmpty() && !merged.IsEmpty() && damage->xMin <= merged.xMax + 1;
+			if (!merged.IsEmpty() && !extendsMerged) {
+				CellRect rect = { (unsigned int)merged.xMin, (unsigned int)merged.yMin,
+					(unsigned int)(merged.xMax - merged.xMin + 1), (unsigned int)(merged.yMax - merged.yMin + 1) };
+				rects->push_back(rect);
+				damagedCells += rect.width * rect.height;
+				merged.Clear();
+			}
+			if (damage && !damage->IsEmpty()) {
+				merged.Include(damage->xMin, damage->yMin, damage->xMax, damage->yMax);
+				damage->Clear();
+			}
+		}
 	}
 
-	if (mouseHeld) {
-		TryCreateInRegion(typeSelected, mouseX, mouseY, brushSize, brushSize);
+	// The brush preview isn't part of the grid, redraw where it was and is now when it moves
+	unsigned int xMin, yMin, xMax, yMax;
+	GetCursorRect(&xMin, &yMin, &xMax, &yMax);
+	CellRect cursorRect = { xMin, yMin, xMax - xMin + 1, yMax - yMin + 1 };
+	bool cursorMoved = cursorRect.x != lastCursorRect.x || cursorRect.y != lastCursorRect.y
+		|| cursorRect.width != lastCursorRect.width || cursorRect.height != lastCursorRect.height;
+	if (cursorMoved || typeSelected != lastCursorType) {
+		rects->push_back(cursorRect);
+		damagedCells += cursorRect.width * cursorRect.height;
+		if (lastCursorRect.width > 0 && cursorMoved) {
+			rects->push_back(lastCursorRect);
+			damagedCells += lastCursorRect.width * lastCursorRect.height;
+		}
+		lastCursorRect = cursorRect;
+		lastCursorType = typeSelected;
 	}
-}
 
-void Simulation::Update() {
-	bool leftToRight = rand() % 2 == 0;
-	if (leftToRight) {
-		UpdateLeftToRight();
-	} else {
-		UpdateRightToLeft();
+	if (damagedCells > DAMAGE_COALESCE_FRACTION * width * height) {
+		rects->clear();
+		rects->push_back({ 0, 0, width, height });
 	}
 }
 
-void Simulation::Render(void* screenBuffer) {
-	uint32_t* pixelData = (uint32_t*)screenBuffer;
-	Particle* currentParticle = particles;
+unsigned int Simulation::GetWidth() {
+	return width;
+}
 
-	unsigned int xMouseMin, yMouseMin, xMouseMax, yMouseMax;
-	GetClampedCoords(mouseX, mouseY, brushSize, brushSize,
-		&xMouseMin, &yMouseMin, &xMouseMax, &yMouseMax);
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			currentParticle->updatedThisFrame = false;
-			switch (currentParticle->type) {
-				case ParticleType::NONE:
-					*pixelData = 0;
-					break;
-				case ParticleType::SAND:
-					*pixelData = SAND_COLOR;
-					break;
-				case ParticleType::WATER:
-					*pixelData = WATER_COLOR;
-					break;
-				case ParticleType::WOOD:
-					*pixelData = WOOD_COLOR;
-					break;
-				case ParticleType::FIRE:
-					*pixelData = FIRE_COLOR;
-					break;
-				case ParticleType::SMOKE:
-					*pixelData = SMOKE_COLOR;
-					break;
-				case ParticleType::STEAM:
-					*pixelData = STEAM_COLOR;
-					break;
-			}
+unsigned int Simulation::GetHeight() {
+	return height;
+}
 
-			if (x >= xMouseMin && x <= xMouseMax && y >= yMouseMin && y <= yMouseMax && currentParticle->IsNone()) {
-				switch (typeSelected) {
-					case ParticleType::SAND:
-						*pixelData = SAND_COLOR_CURSOR;
-						break;
-					case ParticleType::WATER:
-						*pixelData = WATER_COLOR_CURSOR;
-						break;
-					case ParticleType::WOOD:
-						*pixelData = WOOD_COLOR_CURSOR;
-						break;
-					case ParticleType::FIRE:
-						*pixelData = FIRE_COLOR_CURSOR;
-						break;
-					case ParticleType::SMOKE:
-						*pixelData = SMOKE_COLOR_CURSOR;
-						break;
-					case ParticleType::STEAM:
-						*pixelData = STEAM_COLOR_CURSOR;
-						break;
-				}
-			}
+const ParticleType* Simulation::GetTypePlane() {
+	return types.data();
+}
+
+ParticleType Simulation::GetTypeSelected() {
+	return typeSelected;
+}
 
-			currentParticle++;
-			pixelData++;
+void Simulation::GetCursorRect(unsigned int* xMin, unsigned int* yMin, unsigned int* xMax, unsigned int* yMax) {
+	GetClampedCoords(input.mouseX, input.mouseY, input.brushSize, input.brushSize, xMin, yMin, xMax, yMax);
+}
+
+uint64_t Simulation::GetTick() {
+	return tick;
+}
+
+void Simulation::SetBitboardGranular(bool enabled) {
+	// The powder bitmap is only kept up to date while the bitboard pass reads it
+	if (enabled && !bitboardGranular) {
+		for (unsigned int y = 0; y < height; y++) {
+			for (unsigned int x = 0; x < width; x++) {
+				SetPowderBit(x / OCCUPANCY_WORD_BITS + y * bitmapStride, (uint16_t)(1u << (x % OCCUPANCY_WORD_BITS)),
+					types[GetIndex(x, y)]);
+			}
 		}
 	}
+	bitboardGranular = enabled;
 }
 
-void Simulation::RenderUi(float dt) {
-	text->RenderText("Sand(1)", 4.0f, 6.0f, .25f, SAND_COLOR_VEC);
-	text->RenderText("Water(2)", 4.0f, 14.0f, .25f, WATER_COLOR_VEC);
-	text->RenderText("Wood(3)", 4.0f, 22.0f, .25f, WOOD_COLOR_VEC);
-	text->RenderText("Fire(4)", 4.0f, 30.0f, .25f, FIRE_COLOR_VEC);
-	text->RenderText("Smoke(5)", 4.0f, 38.0f, .25f, SMOKE_COLOR_VEC);
-	text->RenderText("Steam(6)", 4.0f, 46.0f, .25f, STEAM_COLOR_VEC);
-	text->RenderText("Brush(scroll)", width - 65.0f, 6.0f, .25f);
-	std::string s(16, '\0');
-	auto written = std::snprintf(&s[0], s.size(), "MS/F %.1f", dt * 1000);
-	s.resize(written);
-	text->RenderText(s, width - 47.0f, 14.0f, .25f);
+bool Simulation::IsBitboardGranular() {
+	return bitboardGranular;
 }
 
-Particle* Simulation::GetParticleAtPosition(unsigned int x, unsigned int y) {
+void Simulation::SetSleepEnabled(bool enabled) {
+	sleepEnabled = enabled;
+	if (!enabled) {
+		std::fill(sleeping.begin(), sleeping.end(), 0);
+	}
+}
+
+bool Simulation::IsSleepEnabled() {
+	return sleepEnabled;
+}
+
+uint64_t Simulation::Hash() {
+	static_assert(sizeof(ParticleType) == 1, "Hash reads the type plane as bytes");
+	uint64_t hash = HashBytes(types.data(), types.size());
+	return HashBytes(lifetimes.data(), lifetimes.size(), hash);
+}
+
+unsigned int Simulation::GetIndex(unsigned int x, unsigned int y) {
 	assert(x < width);
 	assert(y < height);
-	return &particles[x + y * width];
+	return x + y * width;
+}
+
+ParticleType Simulation::GetTypeAtPosition(unsigned int x, unsigned int y) {
+	return types[GetIndex(x, y)];
 }
 
-bool Simulation::TryMoveParticleToPosition(Particle* particle, unsigned int x, unsigned int y) {
-	if (x <= 0 || y <= 0 || x >= width || y >= height || !GetParticleAtPosition(x, y)->IsNone()) {
+bool Simulation::IsUpdated(unsigned int i) {
+	return updateStamps[i] == updateStamp;
+}
+
+void Simulation::MarkUpdated(unsigned int i) {
+	updateStamps[i] = updateStamp;
+}
+
+inline void Simulation::SetType(unsigned int i, unsigned int x, unsigned int y, ParticleType type) {
+	types[i] = type;
+	unsigned int word = x / OCCUPANCY_WORD_BITS + y * bitmapStride;
+	uint16_t bit = (uint16_t)(1u << (x % OCCUPANCY_WORD_BITS));
+	if (type == ParticleType::NONE) {
+		occupancy[word] &= ~bit;
+	} else {
+		occupancy[word] |= bit;
+	}
+	if (bitboardGranular) {
+		SetPowderBit(word, bit, type);
+	}
+}
+
+void Simulation::SetPowderBit(unsigned int word, uint16_t bit, ParticleType type) {
+	uint16_t powderBit = GetMaterial(type).behaviour == Behaviour::POWDER ? bit : 0;
+	powder[word] = (powder[word] & ~bit) | powderBit;
+}
+
+// Powders and liquids only look at their 3x3 neighbourhood and every change wakes the
+// neighbourhood, so one that failed to move would keep failing until it's woken
+void Simulation::PutToSleep(unsigned int x, unsigned int y) {
+	sleeping[x / OCCUPANCY_WORD_BITS + y * bitmapStride] |= (uint16_t)(1u << (x % OCCUPANCY_WORD_BITS));
+}
+
+uint64_t Simulation::GetBits(const std::vector<uint16_t>& bitmap, unsigned int x, unsigned int y, unsigned int count) {
+	assert(count <= 64 - OCCUPANCY_WORD_BITS);
+	const uint16_t* row = &bitmap[y * bitmapStride];
+	unsigned int word = x / OCCUPANCY_WORD_BITS;
+	unsigned int shift = x % OCCUPANCY_WORD_BITS;
+	uint64_t bits = 0;
+	for (unsigned int i = 0; i * OCCUPANCY_WORD_BITS < shift + count && word + i < bitmapStride; i++) {
+		bits |= (uint64_t)row[word + i] << (i * OCCUPANCY_WORD_BITS);
+	}
+	return (bits >> shift) & ((1ULL << count) - 1);
+}
+
+int Simulation::FindOccupiedAfter(int x, int y, int xLast) {
+	const uint16_t* row = &occupancy[y * bitmapStride];
+	while (x <= xLast) {
+		unsigned int bits = row[x / OCCUPANCY_WORD_BITS] >> (x % OCCUPANCY_WORD_BITS);
+		if (bits != 0) {
+			return x + __builtin_ctz(bits);
+		}
+		x = (x / OCCUPANCY_WORD_BITS + 1) * OCCUPANCY_WORD_BITS;
+	}
+	return x;
+}
+
+int Simulation::FindOccupiedBefore(int x, int y, int xFirst) {
+	const uint16_t* row = &occupancy[y * bitmapStride];
+	while (x >= xFirst) {
+		unsigned int bits = row[x / OCCUPANCY_WORD_BITS] & ((2u << (x % OCCUPANCY_WORD_BITS)) - 1);
+		if (bits != 0) {
+			return (x / OCCUPANCY_WORD_BITS) * OCCUPANCY_WORD_BITS + 31 - __builtin_clz(bits);
+		}
+		x = (x / OCCUPANCY_WORD_BITS) * OCCUPANCY_WORD_BITS - 1;
+	}
+	return x;
+}
+
+int Simulation::FindAwakeAfter(int x, int y, int xLast) {
+	const uint16_t* occupiedRow = &occupancy[y * bitmapStride];
+	const uint16_t* sleepingRow = &sleeping[y * bitmapStride];
+	while (x <= xLast) {
+		unsigned int word = x / OCCUPANCY_WORD_BITS;
+		unsigned int bits = (unsigned int)(occupiedRow[word] & ~sleepingRow[word]) >> (x % OCCUPANCY_WORD_BITS);
+		if (bits != 0) {
+			return x + __builtin_ctz(bits);
+		}
+		x = (x / OCCUPANCY_WORD_BITS + 1) * OCCUPANCY_WORD_BITS;
+	}
+	return x;
+}
+
+int Simulation::FindAwakeBefore(int x, int y, int xFirst) {
+	const uint16_t* occupiedRow = &occupancy[y * bitmapStride];
+	const uint16_t* sleepingRow = &sleeping[y * bitmapStride];
+	while (x >= xFirst) {
+		unsigned int word = x / OCCUPANCY_WORD_BITS;
+		unsigned int bits = (unsigned int)(occupiedRow[word] & ~sleepingRow[word]) & ((2u << (x % OCCUPANCY_WORD_BITS)) - 1);
+		if (bits != 0) {
+			return (x / OCCUPANCY_WORD_BITS) * OCCUPANCY_WORD_BITS + 31 - __builtin_clz(bits);
+		}
+		x = (x / OCCUPANCY_WORD_BITS) * OCCUPANCY_WORD_BITS - 1;
+	}
+	return x;
+}
+
+// Wakes the 3x3 neighbourhood of a changed cell, for the rest of this tick and the next,
+// along with any particles asleep in it
+void Simulation::MarkChanged(int x, int y) {
+	MarkChanged(x - 1, y - 1, x + 1, y + 1);
+}
+
+void Simulation::MarkChanged(int xMin, int yMin, int xMax, int yMax) {
+	// Sleepers only look at their own row and the one below, so the changed cells can't
+	// concern any in the rect's bottom row
+	int wakeYMin = std::max(yMin + 1, 0);
+	xMin = std::max(xMin, 0);
+	yMin = std::max(yMin, 0);
+	xMax = std::min(xMax, (int)width - 1);
+	yMax = std::min(yMax, (int)height - 1);
+	for (int cy = yMin / (int)CHUNK_SIZE; cy <= yMax / (int)CHUNK_SIZE; cy++) {
+		for (int cx = xMin / (int)CHUNK_SIZE; cx <= xMax / (int)CHUNK_SIZE; cx++) {
+			int chunkX = cx * CHUNK_SIZE;
+			int chunkY = cy * CHUNK_SIZE;
+			int x0 = std::max(xMin, chunkX);
+			int y0 = std::max(yMin, chunkY);
+			int x1 = std::min(xMax, chunkX + (int)CHUNK_SIZE - 1);
+			int y1 = std::min(yMax, chunkY + (int)CHUNK_SIZE - 1);
+			Chunk& chunk = chunks[cx + cy * chunksWide];
+			chunk.current.Include(x0, y0, x1, y1);
+			chunk.next.Include(x0, y0, x1, y1);
+		}
+	}
+	if (sleepEnabled) {
+		Wake(xMin, wakeYMin, xMax, yMax);
+	}
+}
+
+void Simulation::Wake(int xMin, int yMin, int xMax, int yMax) {
+	// Most changes happen among particles that are awake, so words are only written when they hold a sleeper
+	for (int word = xMin / (int)OCCUPANCY_WORD_BITS; word <= xMax / (int)OCCUPANCY_WORD_BITS; word++) {
+		int first = std::max(xMin - word * (int)OCCUPANCY_WORD_BITS, 0);
+		int last = std::min(xMax - word * (int)OCCUPANCY_WORD_BITS, (int)OCCUPANCY_WORD_BITS - 1);
+		uint16_t mask = (uint16_t)((2u << last) - (1u << first));
+		uint16_t* bits = &sleeping[word + yMin * bitmapStride];
+		for (int y = yMin; y <= yMax; y++, bits += bitmapStride) {
+			if (*bits & mask) {
+				*bits &= ~mask;
+			}
+		}
+	}
+}
+
+void Simulation::MarkDamaged(int x, int y) {
+	chunks[x / CHUNK_SIZE + (y / CHUNK_SIZE) * chunksWide].damage.Include(x, y, x, y);
+}
+
+void Simulation::MarkDamaged(int xMin, int yMin, int xMax, int yMax) {
+	assert(xMin >= 0 && yMin >= 0 && xMin <= xMax && yMin <= yMax);
+	assert(xMax < (int)width && yMax < (int)height);
+	for (int cy = yMin / (int)CHUNK_SIZE; cy <= yMax / (int)CHUNK_SIZE; cy++) {
+		for (int cx = xMin / (int)CHUNK_SIZE; cx <= xMax / (int)CHUNK_SIZE; cx++) {
+			chunks[cx + cy * chunksWide].damage.Include(std::max(xMin, cx * (int)CHUNK_SIZE), std::max(yMin, cy * (int)CHUNK_SIZE),
+				std::min(xMax, (cx + 1) * (int)CHUNK_SIZE - 1), std::min(yMax, (cy + 1) * (int)CHUNK_SIZE - 1));
+		}
+	}
+}
+
+void Simulation::ReassignTo(unsigned int x, unsigned int y, ParticleType type, Random& random) {
+	unsigned int i = GetIndex(x, y);
+	SetType(i, x, y, type);
+	lifetimes[i] = GetInitialLifetime(type, random);
+	MarkChanged(x, y);
+	MarkDamaged(x, y);
+}
+
+bool Simulation::TryMoveParticleToPosition(int fromX, int fromY, unsigned int x, unsigned int y) {
+	if (x <= 0 || y <= 0 || x >= width || y >= height || GetTypeAtPosition(x, y) != ParticleType::NONE) {
 		return false;
 	}
-	Particle* newParticle = GetParticleAtPosition(x, y);
-	newParticle->type = particle->type;
-	newParticle->lifetime = particle->lifetime;
-	newParticle->updatedThisFrame = particle->updatedThisFrame;
-	particle->type = ParticleType::NONE;
-	particle->lifetime = 0;
-	particle->updatedThisFrame = true;
+	unsigned int i = GetIndex(fromX, fromY);
+	unsigned int newIndex = GetIndex(x, y);
+	SetType(newIndex, x, y, types[i]);
+	lifetimes[newIndex] = lifetimes[i];
+	MarkUpdated(newIndex);
+	SetType(i, fromX, fromY, ParticleType::NONE);
+	lifetimes[i] = 0;
+	MarkUpdated(i);
+	MarkChanged(fromX, fromY);
+	MarkChanged(x, y);
+	MarkDamaged(fromX, fromY);
+	MarkDamaged(x, y);
+	return true;
 }
 
 void Simulation::GetClampedCoords(
@@ -198,113 +436,237 @@ void Simulation::GetClampedCoords(
 	*yMax = yMaxResult;
 }
 
-void Simulation::UpdateLeftToRight() {
-	Particle* currentParticle = particles;
-	for (unsigned int y = 0; y < height; y++) {
-		for (unsigned int x = 0; x < width; x++) {
-			UpdateParticle(currentParticle, x, y);
-			currentParticle++;
+void Simulation::UpdateChunk(unsigned int chunkIndex, bool leftToRight) {
+	Random random(seed, tick * chunks.size() + chunkIndex);
+	// The rect is re-read on every step since updating a cell can grow it
+	const DirtyRect& rect = chunks[chunkIndex].current;
+	for (int y = rect.yMin; y <= rect.yMax; y++) {
+		// One random word per row, each cell takes the bit for its column
+		// within the chunk to pick which side it tries first
+		uint64_t sideBits = random.Next();
+		int handledBase = rect.xMin - 1;
+		uint64_t handled = bitboardGranular ? UpdateGranularRow(rect.xMin, rect.xMax, y, sideBits, leftToRight) : 0;
+		auto isHandled = [handled, handledBase](int x) {
+			unsigned int bit = x - handledBase;
+			return bit < 64 && ((handled >> bit) & 1);
+		};
+		// Empty cells and sleeping particles have nothing to update, so the sweeps jump between awake ones
+		auto findAfter = [this, y, &rect](int x) {
+			return sleepEnabled ? FindAwakeAfter(x, y, rect.xMax) : FindOccupiedAfter(x, y, rect.xMax);
+		};
+		auto findBefore = [this, y, &rect](int x) {
+			return sleepEnabled ? FindAwakeBefore(x, y, rect.xMin) : FindOccupiedBefore(x, y, rect.xMin);
+		};
+		if (leftToRight) {
+			for (int x = findAfter(rect.xMin); x <= rect.xMax; x = findAfter(x + 1)) {
+				int leftOrRight = (sideBits >> (x % CHUNK_SIZE)) & 1 ? 1 : -1;
+				if (!isHandled(x)) {
+					UpdateParticle(GetIndex(x, y), x, y, leftOrRight, random);
+				}
+			}
+		} else {
+			for (int x = findBefore(rect.xMax); x >= rect.xMin; x = findBefore(x - 1)) {
+				int leftOrRight = (sideBits >> (x % CHUNK_SIZE)) & 1 ? 1 : -1;
+				if (!isHandled(x)) {
+					UpdateParticle(GetIndex(x, y), x, y, leftOrRight, random);
+				}
+			}
 		}
 	}
 }
 
-void Simulation::UpdateRightToLeft() {
-	Particle* currentParticle = particles;
-	for (unsigned int y = 0; y < height; y++) {
-		currentParticle = &particles[(y + 1) * width - 1];
-		for (int x = width - 1; x >= 0; x--) {
-			UpdateParticle(currentParticle, x, y);
-			currentParticle--;
+uint64_t Simulation::UpdateGranularRow(int xMin, int xMax, int y, uint64_t sideBits, bool leftToRight) {
+	// A chunk row plus the cells diagonally below either end of it fits in one word
+	int base = xMin - 1;
+	unsigned int count = xMax - xMin + 1;
+	// Powder bits are only ever set on occupied cells
+	uint64_t granular = GetBits(powder, xMin, y, count) & ~(sleepEnabled ? GetBits(sleeping, xMin, y, count) : 0);
+	if (granular == 0) {
+		return 0;
+	}
+	granular <<= xMin - base;
+	// Powders that moved down into this row earlier in the tick are done for it
+	for (uint64_t candidates = granular; candidates != 0; candidates &= candidates - 1) {
+		int x = base + __builtin_ctzll(candidates);
+		if (IsUpdated(GetIndex(x, y))) {
+			granular &= ~(1ULL << (x - base));
+		}
+	}
+	if (granular == 0) {
+		return 0;
+	}
+	// Like TryMoveParticleToPosition, never move into the bottom row or the left column
+	uint64_t empty = 0;
+	if (y - 1 > 0) {
+		int x0 = std::max(base, 1);
+		unsigned int belowCount = std::min(xMax + 1, (int)width - 1) - x0 + 1;
+		empty = (~GetBits(occupancy, x0, y - 1, belowCount) & ((1ULL << belowCount) - 1)) << (x0 - base);
+	}
+
+	// Everything that can falls straight down, the rest tries the diagonal on the side
+	// its sideBits bit picks, then the other one
+	uint64_t down = granular & empty;
+	empty &= ~down;
+	uint64_t waiting = granular & ~down;
+	uint64_t rightFirst = (sideBits >> (xMin % CHUNK_SIZE)) << 1;
+	uint64_t movedRight = 0, movedLeft = 0;
+	for (int attempt = 0; attempt < 2 && waiting != 0; attempt++) {
+		uint64_t goRight = waiting & (attempt == 0 ? rightFirst : ~rightFirst);
+		uint64_t rightTargets = (goRight << 1) & empty;
+		uint64_t leftTargets = ((waiting & ~goRight) >> 1) & empty;
+		// Two particles after the same cell, the sweep reaches the one on its near side first
+		if (leftToRight) {
+			leftTargets &= ~rightTargets;
+		} else {
+			rightTargets &= ~leftTargets;
+		}
+		empty &= ~(rightTargets | leftTargets);
+		movedRight |= rightTargets >> 1;
+		movedLeft |= leftTargets << 1;
+		waiting &= ~((rightTargets >> 1) | (leftTargets << 1));
+	}
+
+	// Targets are all distinct empty cells in the row below, so the order moves are made in doesn't matter
+	auto move = [this, base, y](uint64_t moved, int dx) {
+		for (; moved != 0; moved &= moved - 1) {
+			int x = base + __builtin_ctzll(moved);
+			unsigned int i = GetIndex(x, y);
+			unsigned int newIndex = GetIndex(x + dx, y - 1);
+			SetType(newIndex, x + dx, y - 1, types[i]);
+			lifetimes[newIndex] = lifetimes[i];
+			MarkUpdated(newIndex);
+			SetType(i, x, y, ParticleType::NONE);
+			lifetimes[i] = 0;
+			MarkUpdated(i);
 		}
+	};
+	move(down, 0);
+	move(movedRight, 1);
+	move(movedLeft, -1);
+	for (; sleepEnabled && waiting != 0; waiting &= waiting - 1) {
+		PutToSleep(base + __builtin_ctzll(waiting), y);
+	}
+
+	// Dirty rects are bounding boxes, so waking and damaging the span of the moves once
+	// covers the same cells as doing it per move the way TryMoveParticleToPosition does.
+	// The span comes from the columns actually moved from and to, which are all in the grid.
+	uint64_t touched = down | movedRight | movedLeft | (movedRight << 1) | (movedLeft >> 1);
+	if (touched != 0) {
+		int xFirst = base + __builtin_ctzll(touched);
+		int xLast = base + 63 - __builtin_clzll(touched);
+		MarkChanged(xFirst - 1, y - 2, xLast + 1, y + 1);
+		MarkDamaged(xFirst, y - 1, xLast, y);
 	}
+	return granular;
 }
 
-void Simulation::UpdateParticle(Particle* particle, int x, int y) {
-	if (particle->updatedThisFrame) {
+void Simulation::UpdateParticle(unsigned int i, int x, int y, int leftOrRight, Random& random) {
+	if (IsUpdated(i)) {
 		return;
 	}
-	particle->updatedThisFrame = true;
-	int leftOrRight = rand() % 2 == 0 ? -1 : 1;
-	if (particle->type == ParticleType::SAND) {
-		if (y > 0) {
-			TryMoveParticleToPosition(particle, x, y - 1) ||
-				TryMoveParticleToPosition(particle, x + leftOrRight, y - 1) ||
-				TryMoveParticleToPosition(particle, x - leftOrRight, y - 1);
+	MarkUpdated(i);
+	switch (GetMaterial(types[i]).behaviour) {
+	case Behaviour::STATIC:
+		if (sleepEnabled) {
+			PutToSleep(x, y);
 		}
-	} else if (particle->type == ParticleType::WATER) {
-		Flow(particle, x, y, leftOrRight);
-	} else if (particle->type == ParticleType::FIRE) {
-		particle->lifetime--;
-		if (particle->lifetime <= 0) {
-			particle->lifetime = 0;
-			particle->type = ParticleType::NONE;
-		} else if (y > 0 && GetParticleAtPosition(x, y - 1)->type == ParticleType::WATER) {
-			particle->ReassignTo(ParticleType::STEAM);
-			GetParticleAtPosition(x, y - 1)->ReassignTo(ParticleType::STEAM);
-		} else {
-			unsigned int xMin, yMin, xMax, yMax;
-			GetClampedCoords(x, y, 1, 1, &xMin, &yMin, &xMax, &yMax);
-			bool didCatchFire = false;
-			for (unsigned int j = yMin; j < yMax; j++) {
-				for (unsigned int i = xMin; i < xMax; i++) {
-					if (GetParticleAtPosition(i, j)->type == ParticleType::WOOD && ShouldCatchFire()) {
-						GetParticleAtPosition(i, j)->ReassignTo(ParticleType::FIRE);
-						didCatchFire = true;
-						TryCreateInRegion(ParticleType::SMOKE, i, j + 2, 3, 2);
-					}
-				}
-			}
-			if (!didCatchFire) {
-				Flow(particle, x, y, leftOrRight);
-			}
+		break;
+	case Behaviour::POWDER:
+		if (!(y > 0 && (TryMoveParticleToPosition(x, y, x, y - 1) ||
+			TryMoveParticleToPosition(x, y, x + leftOrRight, y - 1) ||
+			TryMoveParticleToPosition(x, y, x - leftOrRight, y - 1))) && sleepEnabled) {
+			PutToSleep(x, y);
 		}
-	} else if (particle->type == ParticleType::SMOKE || particle->type == ParticleType::STEAM) {
-		particle->lifetime--;
-		if (particle->lifetime <= 0) {
-			particle->lifetime = 0;
-			particle->type = ParticleType::NONE;
-		} else {
-			Float(particle, x, y, leftOrRight);
+		break;
+	case Behaviour::LIQUID:
+		if (!Flow(x, y, leftOrRight) && sleepEnabled) {
+			PutToSleep(x, y);
+		}
+		break;
+	case Behaviour::FIRE:
+		if (Age(i, x, y)) {
+			Burn(x, y, leftOrRight, random);
+		}
+		break;
+	case Behaviour::GAS:
+		if (Age(i, x, y)) {
+			Float(x, y, leftOrRight);
+		}
+		break;
+	}
+}
+
+bool Simulation::Age(unsigned int i, int x, int y) {
+	lifetimes[i]--;
+	MarkChanged(x, y);
+	if (lifetimes[i] == 0) {
+		SetType(i, x, y, ParticleType::NONE);
+		MarkDamaged(x, y);
+		return false;
+	}
+	return true;
+}
+
+void Simulation::Burn(int x, int y, int leftOrRight, Random& random) {
+	if (y > 0 && GetMaterial(GetTypeAtPosition(x, y - 1)).quenchesFire) {
+		ReassignTo(x, y, ParticleType::STEAM, random);
+		ReassignTo(x, y - 1, ParticleType::STEAM, random);
+		return;
+	}
+
+	unsigned int xMin, yMin, xMax, yMax;
+	GetClampedCoords(x, y, 1, 1, &xMin, &yMin, &xMax, &yMax);
+	bool didCatchFire = false;
+	for (unsigned int j = yMin; j < yMax; j++) {
+		for (unsigned int k = xMin; k < xMax; k++) {
+			if (GetMaterial(GetTypeAtPosition(k, j)).flammable && ShouldCatchFire(random)) {
+				ReassignTo(k, j, ParticleType::FIRE, random);
+				didCatchFire = true;
+				TryCreateInRegion(ParticleType::SMOKE, k, j + 2, 3, 2, random);
+			}
 		}
 	}
+	if (!didCatchFire) {
+		Flow(x, y, leftOrRight);
+	}
 }
 
-void Simulation::Flow(Particle* particle, int x, int y, int leftOrRight) {
+bool Simulation::Flow(int x, int y, int leftOrRight) {
 	bool didMove = y > 0 &&
-		(TryMoveParticleToPosition(particle, x, y - 1) ||
-			TryMoveParticleToPosition(particle, x + leftOrRight, y - 1) ||
-			TryMoveParticleToPosition(particle, x - leftOrRight, y - 1));
+		(TryMoveParticleToPosition(x, y, x, y - 1) ||
+			TryMoveParticleToPosition(x, y, x + leftOrRight, y - 1) ||
+			TryMoveParticleToPosition(x, y, x - leftOrRight, y - 1));
 
 	if (!didMove) {
-		TryMoveParticleToPosition(particle, x + leftOrRight, y) || TryMoveParticleToPosition(particle, x - leftOrRight, y);
+		didMove = TryMoveParticleToPosition(x, y, x + leftOrRight, y) || TryMoveParticleToPosition(x, y, x - leftOrRight, y);
 	}
+	return didMove;
 }
 
-void Simulation::Float(Particle* particle, int x, int y, int leftOrRight) {
+void Simulation::Float(int x, int y, int leftOrRight) {
 	bool didMove = false;
-	if (y + 1 < height) {
-		didMove = TryMoveParticleToPosition(particle, x, y + 1) ||
-			TryMoveParticleToPosition(particle, x + leftOrRight, y + 1) ||
-			TryMoveParticleToPosition(particle, x - leftOrRight, y + 1);
+	if (y + 1 < (int)height) {
+		didMove = TryMoveParticleToPosition(x, y, x, y + 1) ||
+			TryMoveParticleToPosition(x, y, x + leftOrRight, y + 1) ||
+			TryMoveParticleToPosition(x, y, x - leftOrRight, y + 1);
 	}
 
 	if (!didMove) {
-		didMove = TryMoveParticleToPosition(particle, x + leftOrRight, y) || TryMoveParticleToPosition(particle, x - leftOrRight, y);
+		didMove = TryMoveParticleToPosition(x, y, x + leftOrRight, y) || TryMoveParticleToPosition(x, y, x - leftOrRight, y);
 	}
 
 	if (!didMove) {
+		// Tunnelling is capped at CHUNK_REACH rows per tick so chunk updates can run in parallel
 		int j = y + 1;
-		Particle* particleAbove;
-		while (j < height) {
-			particleAbove = GetParticleAtPosition(x, j);
-			if (particleAbove->IsNone()) {
-				TryMoveParticleToPosition(particle, x, j);
+		int jMax = std::min(y + CHUNK_REACH, (int)height - 1);
+		ParticleType typeAbove;
+		while (j <= jMax) {
+			typeAbove = GetTypeAtPosition(x, j);
+			if (typeAbove == ParticleType::NONE) {
+				TryMoveParticleToPosition(x, y, x, j);
 				break;
-			} else if (!(particleAbove->type == ParticleType::FIRE ||
-				particleAbove->type == ParticleType::WATER ||
-				particleAbove->type == ParticleType::SMOKE ||
-				particleAbove->type == ParticleType::STEAM)) {
-				// Can only move through fire/water/smoke/steam
+			} else if (!IsFluid(typeAbove)) {
+				// Can only move through liquids, fire and gases
 				break;
 			}
 			j += 5;
@@ -313,13 +675,17 @@ void Simulation::Float(Particle* particle, int x, int y, int leftOrRight) {
 }
 
 void Simulation::TryCreateInRegion(ParticleType type, int x, int y, int xDist, int yDist) {
+	TryCreateInRegion(type, x, y, xDist, yDist, random);
+}
+
+void Simulation::TryCreateInRegion(ParticleType type, int x, int y, int xDist, int yDist, Random& random) {
 	unsigned int xMouseMin, yMouseMin, xMouseMax, yMouseMax;
 	GetClampedCoords(x, y, xDist, yDist,
 		&xMouseMin, &yMouseMin, &xMouseMax, &yMouseMax);
 	for (unsigned int j = yMouseMin; j < yMouseMax; j++) {
 		for (unsigned int i = xMouseMin; i < xMouseMax; i++) {
-			if (GetParticleAtPosition(i, j)->IsNone()) {
-				GetParticleAtPosition(i, j)->ReassignTo(type);
+			if (GetTypeAtPosition(i, j) == ParticleType::NONE) {
+				ReassignTo(i, j, type, random);
 			}
 		}
 	}
@@ -1,37 +1,167 @@
 #pragma once
 
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "chunk.h"
 #include "particle.h"
+#include "random.h"
+#include "worker_pool.h"
 
-class Simulation {
-public:
+constexpr uint64_t DEFAULT_SEED = 0x5EED;
+
+// Everything the user can do to the simulation, read once per tick by ProcessInput
+struct InputState {
 	unsigned int mouseX = 0, mouseY = 0;
 	bool mouseHeld = false;
 	unsigned int lastNumKeyPressed = 0;
 	unsigned int brushSize = 2;
 
-	Simulation(unsigned int width, unsigned int height);
+	bool operator==(const InputState& other) const {
+		return mouseX == other.mouseX && mouseY == other.mouseY && mouseHeld == other.mouseHeld &&
+			lastNumKeyPressed == other.lastNumKeyPressed && brushSize == other.brushSize;
+	}
+	bool operator!=(const InputState& other) const {
+		return !(*this == other);
+	}
+};
+
+// A rectangle of cells, x and y being the bottom-left cell
+struct CellRect {
+	unsigned int x, y, width, height;
+};
+
+// Past this fraction of the grid, damage is handled as one full rect. Rewriting the
+// whole grid is as quick as going rect by rect by then.
+constexpr float DAMAGE_COALESCE_FRACTION = 0.5f;
+
+// Given the same size, seed and per-tick input the simulation produces the same
+// grid bit for bit, whatever threadCount is.
+class Simulation {
+public:
+	InputState input;
+
+	// threadCount is the number of threads Update may use, including the caller
+	Simulation(unsigned int width, unsigned int height, unsigned int threadCount = 1, uint64_t seed = DEFAULT_SEED);
+	// Init and RenderUi need a GL context and live in simulation_ui.cpp,
+	// everything else can be driven headless (see bench.cpp).
 	void Init();
 	void ProcessInput();
 	void Update();
 	void Render(void* screenBuffer);
-	void RenderUi(float dt);
+	// Colors only the cells in rect into pixels, whose rows are stride pixels apart
+	void RenderRect(const CellRect& rect, uint32_t* pixels, unsigned int stride);
+	// Replaces rects with the areas whose colors may have changed since the last call,
+	// including the brush preview, and starts tracking afresh. Large damage is
+	// coalesced into a single rect covering the whole grid.
+	void TakeDamage(std::vector<CellRect>* rects);
+	// lag is how many ticks behind real time the simulation is and droppedTicks how many it
+	// has skipped so far, from FixedTimestep::GetLag and GetDroppedTicks
+	void RenderUi(float dt, float lag, uint64_t droppedTicks);
+	void TryCreateInRegion(ParticleType type, int x, int y, int xDist, int yDist);
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+	// One byte per cell, row-major starting from the bottom row, for uploading to the GPU
+	const ParticleType* GetTypePlane();
+	ParticleType GetTypeSelected();
+	// Inclusive cell bounds of the brush preview
+	void GetCursorRect(unsigned int* xMin, unsigned int* yMin, unsigned int* xMax, unsigned int* yMax);
+	uint64_t GetTick();
+	// Moves powders a whole chunk row at a time with bitwise ops on masks of the row,
+	// instead of one cell at a time. Piles settle the same way but not cell for cell
+	// the same, so replays must use the setting they were recorded with.
+	void SetBitboardGranular(bool enabled);
+	bool IsBitboardGranular();
+	// Skips particles that failed to move until something next to them changes. The grid
+	// comes out the same either way, but the bookkeeping only pays for itself where most
+	// particles have settled, like basins of water, and slows down scenes full of falling sand.
+	void SetSleepEnabled(bool enabled);
+	bool IsSleepEnabled();
+	// FNV-1a over the type and lifetime planes, for checking replays
+	uint64_t Hash();
 
 private:
 	unsigned int width, height;
-	Particle* particles;
+	// Cells are stored as structure of arrays, indexed by x + y * width
+	std::vector<ParticleType> types;
+	std::vector<uint8_t> lifetimes;
+	// A cell has been updated this tick when its stamp equals updateStamp.
+	// Stamps are wiped every STAMP_PERIOD ticks so old ones can never match.
+	std::vector<uint8_t> updateStamps;
+	uint8_t updateStamp = 0;
+	// Bitmaps with one bit per cell, in 16 cell words with bitmapStride words a row.
+	// Lets the update loops jump over air and settled particles.
+	unsigned int bitmapStride;
+	// Set unless the cell is empty
+	std::vector<uint16_t> occupancy;
+	// Set for particles whose material behaves as a powder, while the bitboard pass is on
+	std::vector<uint16_t> powder;
+	// Set for particles that failed to move last time they were updated, while sleep is
+	// enabled. They're skipped until a change in their 3x3 neighbourhood wakes them.
+	std::vector<uint16_t> sleeping;
+	// Chunks in row-major order, only their dirty rects are updated each tick
+	unsigned int chunksWide, chunksHigh;
+	std::vector<Chunk> chunks;
+	std::vector<unsigned int> phaseChunks;
+	std::unique_ptr<WorkerPool> workers;
+	// Chunk updates draw from their own stream, derived from seed, tick and chunk index.
+	// Everything on the calling thread (input, picking the sweep direction) uses random.
+	uint64_t seed;
+	uint64_t tick = 0;
+	Random random;
 	ParticleType typeSelected = ParticleType::SAND;
+	bool bitboardGranular = false;
+	bool sleepEnabled = false;
+	// Brush preview as of the last TakeDamage, so moving it damages where it was
+	CellRect lastCursorRect = { 0, 0, 0, 0 };
+	ParticleType lastCursorType = ParticleType::NONE;
 
-	Particle* GetParticleAtPosition(unsigned int x, unsigned int y);
-	bool TryMoveParticleToPosition(Particle* particle, unsigned int x, unsigned int y);
+	unsigned int GetIndex(unsigned int x, unsigned int y);
+	ParticleType GetTypeAtPosition(unsigned int x, unsigned int y);
+	bool IsUpdated(unsigned int i);
+	void MarkUpdated(unsigned int i);
+	// Every write to types goes through here to keep occupancy and powder in step, i being the index of (x, y)
+	void SetType(unsigned int i, unsigned int x, unsigned int y, ParticleType type);
+	// SetType's upkeep of the powder bitmap, kept apart so SetType stays small enough to inline
+	void SetPowderBit(unsigned int word, uint16_t bit, ParticleType type);
+	// Only called while sleep is enabled
+	void PutToSleep(unsigned int x, unsigned int y);
+	// Bit i is the bitmap's bit for cell (x + i, y), for up to 48 cells
+	uint64_t GetBits(const std::vector<uint16_t>& bitmap, unsigned int x, unsigned int y, unsigned int count);
+	// First occupied cell of row y in [x, xLast], or some column past xLast when there's none
+	int FindOccupiedAfter(int x, int y, int xLast);
+	// Last occupied cell of row y in [xFirst, x], or some column before xFirst when there's none
+	int FindOccupiedBefore(int x, int y, int xFirst);
+	// First cell of row y in [x, xLast] with a particle that's awake, or some column past xLast when there's none
+	int FindAwakeAfter(int x, int y, int xLast);
+	// Last cell of row y in [xFirst, x] with a particle that's awake, or some column before xFirst when there's none
+	int FindAwakeBefore(int x, int y, int xFirst);
+	void MarkChanged(int x, int y);
+	// Wakes every cell of the inclusive rect, which is clamped to the grid
+	void MarkChanged(int xMin, int yMin, int xMax, int yMax);
+	// Clears the sleeping bits of the inclusive rect, which must be within the grid
+	void Wake(int xMin, int yMin, int xMax, int yMax);
+	void MarkDamaged(int x, int y);
+	// Inclusive rect, which must be within the grid
+	void MarkDamaged(int xMin, int yMin, int xMax, int yMax);
+	void ReassignTo(unsigned int x, unsigned int y, ParticleType type, Random& random);
+	bool TryMoveParticleToPosition(int fromX, int fromY, unsigned int x, unsigned int y);
 	void GetClampedCoords(
 		unsigned int x, unsigned int y,
 		unsigned int xDist, unsigned int yDist,
 		unsigned int* xMin, unsigned int* yMin,
 		unsigned int* xMax, unsigned int* yMax);
-	void UpdateLeftToRight();
-	void UpdateRightToLeft();
-	void UpdateParticle(Particle* particle, int x, int y);
-	void Flow(Particle* particle, int x, int y, int leftOrRight);
-	void Float(Particle* particle, int x, int y, int leftOrRight);
-	void TryCreateInRegion(ParticleType type, int x, int y, int xDist, int yDist);
+	void UpdateChunk(unsigned int chunkIndex, bool leftToRight);
+	// Moves the powders in [xMin, xMax] of row y, returning which columns it handled
+	// with bit i standing for column xMin - 1 + i
+	uint64_t UpdateGranularRow(int xMin, int xMax, int y, uint64_t sideBits, bool leftToRight);
+	void UpdateParticle(unsigned int i, int x, int y, int leftOrRight, Random& random);
+	// Counts down the particle's lifetime, removing it and returning false once it runs out
+	bool Age(unsigned int i, int x, int y);
+	void Burn(int x, int y, int leftOrRight, Random& random);
+	// Returns whether the particle moved
+	bool Flow(int x, int y, int leftOrRight);
+	void Float(int x, int y, int leftOrRight);
+	void TryCreateInRegion(ParticleType type, int x, int y, int xDist, int yDist, Random& random);
 };
\ No newline at end of file
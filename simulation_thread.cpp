@@ -0,0 +1,118 @@
+#include "simulation_thread.h"
+
+#include <string.h>
+
+#include <chrono>
+
+SimulationThread::SimulationThread(Simulation& simulation, FrameFormat format, InputLog* inputLog, FixedTimestep clock) :
+	simulation(simulation), format(format), inputLog(inputLog), clock(clock) {
+}
+
+SimulationThread::~SimulationThread() {
+	Stop();
+}
+
+void SimulationThread::Start() {
+	if (running) {
+		return;
+	}
+	running = true;
+	thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void SimulationThread::SetInput(const InputState& input) {
+	inputs.GetWriteBuffer() = input;
+	inputs.Publish();
+}
+
+bool SimulationThread::AcquireFrame() {
+	return frames.Acquire();
+}
+
+const Frame& SimulationThread::GetFrame() {
+	return frames.GetReadBuffer();
+}
+
+void SimulationThread::Run() {
+	auto lastStep = std::chrono::steady_clock::now();
+	while (running) {
+		auto now = std::chrono::steady_clock::now();
+		unsigned int ticks = clock.Advance(std::chrono::duration<double>(now - lastStep).count());
+		lastStep = now;
+
+		if (inputs.Acquire()) {
+			simulation.input = inputs.GetReadBuffer();
+		}
+		for (unsigned int i = 0; i < ticks; i++) {
+			if (inputLog) {
+				inputLog->Record(simulation.input);
+			}
+			simulation.ProcessInput();
+			simulation.Update();
+		}
+		// Damage builds up over all the ticks of the step, so one frame covers them all
+		if (ticks > 0) {
+			PublishFrame();
+		}
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(clock.GetTimeToNextTick()));
+	}
+}
+
+void SimulationThread::PublishFrame() {
+	Frame& frame = frames.GetWriteBuffer();
+	unsigned int width = simulation.GetWidth();
+	unsigned int height = simulation.GetHeight();
+
+	// The slot still holds the frame it was last written with, so it only needs
+	// the damage of every frame published since then, this one included
+	uint64_t lastSequence = frame.sequence;
+	frame.sequence = nextSequence++;
+	frame.tick = simulation.GetTick();
+	frame.lag = clock.GetLag();
+	frame.droppedTicks = clock.GetDroppedTicks();
+	simulation.TakeDamage(&frame.damage);
+	damageHistory[frame.sequence % DAMAGE_HISTORY] = frame.damage;
+	unsigned int xMin, yMin, xMax, yMax;
+	simulation.GetCursorRect(&xMin, &yMin, &xMax, &yMax);
+	frame.cursorRect = { xMin, yMin, xMax - xMin + 1, yMax - yMin + 1 };
+	frame.typeSelected = simulation.GetTypeSelected();
+
+	staleRects.clear();
+	size_t staleCells = 0;
+	bool rewriteAll = lastSequence == 0 || frame.sequence - lastSequence > DAMAGE_HISTORY;
+	for (uint64_t sequence = lastSequence + 1; !rewriteAll && sequence <= frame.sequence; sequence++) {
+		for (const CellRect& rect : damageHistory[sequence % DAMAGE_HISTORY]) {
+			staleRects.push_back(rect);
+			staleCells += (size_t)rect.width * rect.height;
+		}
+	}
+	// Same cut-off as TakeDamage
+	if (rewriteAll || staleCells > DAMAGE_COALESCE_FRACTION * width * height) {
+		staleRects.assign(1, { 0, 0, width, height });
+	}
+
+	if (format == FrameFormat::TYPES) {
+		frame.types.resize((size_t)width * height);
+		const ParticleType* types = simulation.GetTypePlane();
+		for (const CellRect& rect : staleRects) {
+			for (unsigned int y = rect.y; y < rect.y + rect.height; y++) {
+				size_t offset = (size_t)y * width + rect.x;
+				memcpy(&frame.types[offset], types + offset, rect.width * sizeof(ParticleType));
+			}
+		}
+	} else {
+		frame.pixels.resize((size_t)width * height);
+		for (const CellRect& rect : staleRects) {
+			simulation.RenderRect(rect, &frame.pixels[(size_t)rect.y * width + rect.x], width);
+		}
+	}
+	frames.Publish();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "fixed_timestep.h"
+#include "input_log.h"
+#include "simulation.h"
+#include "triple_buffer.h"
+
+enum class FrameFormat {
+	// Frames carry the type plane, to be colored on the GPU
+	TYPES,
+	// Frames carry RGBA pixels colored by Simulation::Render
+	PIXELS,
+};
+
+// The grid after a step of one or more ticks, as handed to the render thread
+struct Frame {
+	// Frames are numbered in the order they were published
+	uint64_t sequence = 0;
+	uint64_t tick = 0;
+	std::vector<ParticleType> types;
+	std::vector<uint32_t> pixels;
+	// Areas that changed since the previous frame
+	std::vector<CellRect> damage;
+	CellRect cursorRect = { 0, 0, 0, 0 };
+	ParticleType typeSelected = ParticleType::NONE;
+	// From FixedTimestep::GetLag and GetDroppedTicks as of this frame
+	float lag = 0;
+	uint64_t droppedTicks = 0;
+};
+
+// Frames whose damage is kept to bring a triple buffer slot up to date. A slot
+// last written longer ago than this is rewritten whole.
+constexpr unsigned int DAMAGE_HISTORY = 8;
+
+// Runs a Simulation on its own thread at a fixed tick rate, taking input from
+// and publishing frames to the render thread through triple buffers, so a slow
+// tick never holds up a frame and vsync never holds up a tick.
+class SimulationThread {
+public:
+	// If inputLog isn't null, the input of every tick is recorded into it
+	SimulationThread(Simulation& simulation, FrameFormat format, InputLog* inputLog, FixedTimestep clock = FixedTimestep());
+	~SimulationThread();
+
+	void Start();
+	// Returns once the current tick has finished, after which simulation may be used directly again
+	void Stop();
+
+	// Render thread only: the input to use from the next tick on
+	void SetInput(const InputState& input);
+	// Render thread only: switches to the latest frame, returning false if there is none newer
+	bool AcquireFrame();
+	const Frame& GetFrame();
+
+private:
+	Simulation& simulation;
+	FrameFormat format;
+	InputLog* inputLog;
+	FixedTimestep clock;
+	uint64_t nextSequence = 1;
+	// Damage of the last few frames published, by sequence modulo DAMAGE_HISTORY
+	std::vector<CellRect> damageHistory[DAMAGE_HISTORY];
+	// Areas of the frame being written that are older than the grid
+	std::vector<CellRect> staleRects;
+	TripleBuffer<InputState> inputs;
+	TripleBuffer<Frame> frames;
+	std::atomic<bool> running{ false };
+	std::thread thread;
+
+	void Run();
+	void PublishFrame();
+};
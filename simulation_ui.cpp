@@ -0,0 +1,42 @@
+#include <cstdio>
+
+#include "simulation.h"
+#include "text_renderer.h"
+
+TextRenderer* text;
+// Labels whose text changes while running
+unsigned int frameTimeLabel, lagLabel, droppedLabel;
+
+void Simulation::Init() {
+	text = new TextRenderer(this->width, this->height);
+	text->Load("resources/fonts/LiberationMono-Regular.ttf", 24, GlyphMode::SDF);
+
+	// One label per selectable material, in the material's own color
+	float y = 6.0f;
+	for (const Material& material : MATERIALS) {
+		if (material.key == 0) {
+			continue;
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "%s(%u)", material.name, material.key);
+		glm::vec3 color = glm::vec3((material.color & 0xFF) / 255.0f, ((material.color >> 8) & 0xFF) / 255.0f,
+			((material.color >> 16) & 0xFF) / 255.0f);
+		text->AddLabel(name, 4.0f, y, .25f, color);
+		y += 8.0f;
+	}
+	text->AddLabel("Brush(scroll)", width - 65.0f, 6.0f, .25f);
+	frameTimeLabel = text->AddLabel("", width - 47.0f, 14.0f, .25f, glm::vec3(1.0f), 12);
+	lagLabel = text->AddLabel("", width - 47.0f, 22.0f, .25f, glm::vec3(1.0f), 12);
+	droppedLabel = text->AddLabel("", width - 47.0f, 30.0f, .25f, glm::vec3(1.0f), 12);
+}
+
+void Simulation::RenderUi(float dt, float lag, uint64_t droppedTicks) {
+	char s[24];
+	std::snprintf(s, sizeof(s), "MS/F %.1f", dt * 1000);
+	text->SetLabelText(frameTimeLabel, s);
+	std::snprintf(s, sizeof(s), "LAG %.1f", lag);
+	text->SetLabelText(lagLabel, s);
+	std::snprintf(s, sizeof(s), "DROP %llu", (unsigned long long)droppedTicks);
+	text->SetLabelText(droppedLabel, s);
+	text->RenderLabels();
+}
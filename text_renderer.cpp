@@ -1,128 +1,388 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "text_renderer.h"
+#include "fnv.h"
+#include "mapped_file.h"
 #include "resource_manager.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
-#include <vector>
+
+constexpr unsigned int FLOATS_PER_VERTEX = 7;
+// the atlas is this wide unless the glyphs need more, then the next power of two that fits them
+constexpr unsigned int MIN_ATLAS_WIDTH = 256;
+// gap between glyphs in the atlas so linear filtering doesn't bleed neighbours in
+constexpr int ATLAS_PADDING = 1;
+
+// SDF glyphs are always rasterized this small and scaled up to the font size when drawn
+constexpr unsigned int SDF_RASTER_SIZE = 12;
+// pixels of distance field kept around each glyph, and the value on its outline
+constexpr int SDF_PADDING = 2;
+constexpr unsigned char SDF_ON_EDGE = 128;
+
+// Rasterized atlases are cached here, one file per font path, size and mode. Layout, little endian:
+//   "FATL", version, font size, glyph mode, path hash, font file hash, glyph count, atlas width, atlas height
+//   per glyph: uvMin, uvMax, size, bearing, advance
+//   atlas pixels, one byte each
+const char* ATLAS_CACHE_DIRECTORY = "resources/cache/";
+constexpr char ATLAS_CACHE_MAGIC[4] = { 'F', 'A', 'T', 'L' };
+constexpr uint32_t ATLAS_CACHE_VERSION = 2;
+constexpr size_t ATLAS_CACHE_HEADER_SIZE = 44;
+constexpr size_t ATLAS_CACHE_GLYPH_SIZE = 36;
+
+template <typename T>
+void WriteCacheValue(std::ofstream& file, T value) {
+  file.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+T ReadCacheValue(const unsigned char*& cursor) {
+  T value;
+  memcpy(&value, cursor, sizeof(T));
+  cursor += sizeof(T);
+  return value;
+}
+
+// fills in characters and atlas from the cache file if it was made from the same font file at the same size
+bool LoadAtlasCache(const std::string& path, uint64_t pathHash, uint64_t fileHash, unsigned int fontSize, GlyphMode mode,
+  Character* characters, Texture2D& atlas) {
+  MappedFile file(path);
+  if (!file.IsOpen() || file.GetSize() < ATLAS_CACHE_HEADER_SIZE || memcmp(file.GetData(), ATLAS_CACHE_MAGIC, 4) != 0) {
+    return false;
+  }
+
+  const unsigned char* cursor = file.GetData() + sizeof(ATLAS_CACHE_MAGIC);
+  uint32_t version = ReadCacheValue<uint32_t>(cursor);
+  uint32_t cachedFontSize = ReadCacheValue<uint32_t>(cursor);
+  uint32_t cachedMode = ReadCacheValue<uint32_t>(cursor);
+  uint64_t cachedPathHash = ReadCacheValue<uint64_t>(cursor);
+  uint64_t cachedFileHash = ReadCacheValue<uint64_t>(cursor);
+  uint32_t glyphCount = ReadCacheValue<uint32_t>(cursor);
+  uint32_t atlasWidth = ReadCacheValue<uint32_t>(cursor);
+  uint32_t atlasHeight = ReadCacheValue<uint32_t>(cursor);
+  if (version != ATLAS_CACHE_VERSION || cachedFontSize != fontSize || cachedMode != (uint32_t)mode || cachedPathHash != pathHash ||
+    cachedFileHash != fileHash || glyphCount != GLYPH_COUNT ||
+    file.GetSize() != ATLAS_CACHE_HEADER_SIZE + GLYPH_COUNT * ATLAS_CACHE_GLYPH_SIZE + (size_t)atlasWidth * atlasHeight) {
+    return false;
+  }
+
+  for (unsigned int c = 0; c < GLYPH_COUNT; c++) {
+    Character& ch = characters[c];
+    ch.uvMin.x = ReadCacheValue<float>(cursor);
+    ch.uvMin.y = ReadCacheValue<float>(cursor);
+    ch.uvMax.x = ReadCacheValue<float>(cursor);
+    ch.uvMax.y = ReadCacheValue<float>(cursor);
+    ch.size.x = ReadCacheValue<float>(cursor);
+    ch.size.y = ReadCacheValue<float>(cursor);
+    ch.bearing.x = ReadCacheValue<float>(cursor);
+    ch.bearing.y = ReadCacheValue<float>(cursor);
+    ch.advance = ReadCacheValue<int32_t>(cursor);
+  }
+  // the pixels go to GL straight out of the mapping
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  atlas.Generate(atlasWidth, atlasHeight, (unsigned char*)cursor);
+  return true;
+}
+
+void SaveAtlasCache(const std::string& path, uint64_t pathHash, uint64_t fileHash, unsigned int fontSize, GlyphMode mode,
+  const Character* characters, unsigned int atlasWidth, unsigned int atlasHeight, const std::vector<unsigned char>& pixels) {
+  bool written = WriteFileAtomically(path, [&](std::ofstream& file) {
+    file.write(ATLAS_CACHE_MAGIC, sizeof(ATLAS_CACHE_MAGIC));
+    WriteCacheValue<uint32_t>(file, ATLAS_CACHE_VERSION);
+    WriteCacheValue<uint32_t>(file, fontSize);
+    WriteCacheValue<uint32_t>(file, (uint32_t)mode);
+    WriteCacheValue<uint64_t>(file, pathHash);
+    WriteCacheValue<uint64_t>(file, fileHash);
+    WriteCacheValue<uint32_t>(file, GLYPH_COUNT);
+    WriteCacheValue<uint32_t>(file, atlasWidth);
+    WriteCacheValue<uint32_t>(file, atlasHeight);
+    for (unsigned int c = 0; c < GLYPH_COUNT; c++) {
+      const Character& ch = characters[c];
+      WriteCacheValue<float>(file, ch.uvMin.x);
+      WriteCacheValue<float>(file, ch.uvMin.y);
+      WriteCacheValue<float>(file, ch.uvMax.x);
+      WriteCacheValue<float>(file, ch.uvMax.y);
+      WriteCacheValue<float>(file, ch.size.x);
+      WriteCacheValue<float>(file, ch.size.y);
+      WriteCacheValue<float>(file, ch.bearing.x);
+      WriteCacheValue<float>(file, ch.bearing.y);
+      WriteCacheValue<int32_t>(file, ch.advance);
+    }
+    file.write((const char*)pixels.data(), pixels.size());
+  });
+  if (!written) {
+    std::cout << "Failed to write font atlas cache: " << path << std::endl;
+  }
+}
 
 TextRenderer::TextRenderer(unsigned int width, unsigned int height) {
-  this->textShader = ResourceManager::LoadShader("resources/shaders/text_2d.vs", "resources/shaders/text_2d.fs", nullptr, "text");
-  this->textShader.SetMatrix4("projection", glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f), true);
-  this->textShader.SetInteger("text", 0);
-  glGenVertexArrays(1, &this->VAO);
-  glGenBuffers(1, &this->VBO);
-  glBindVertexArray(this->VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+  this->projection = glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f);
+  this->atlas.internal_format = GL_R8;
+  this->atlas.image_format = GL_RED;
+  this->atlas.wrap_s = GL_CLAMP_TO_EDGE;
+  this->atlas.wrap_t = GL_CLAMP_TO_EDGE;
+  CreateVertexArray(&this->VAO, &this->VBO);
+  CreateVertexArray(&this->labelVAO, &this->labelVBO);
+}
+
+void TextRenderer::CreateVertexArray(unsigned int* vao, unsigned int* vbo) {
+  glGenVertexArrays(1, vao);
+  glGenBuffers(1, vbo);
+  glBindVertexArray(*vao);
+  glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+  // position and texture coords
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), 0);
+  // color
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(4 * sizeof(float)));
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindVertexArray(0);
 }
 
-void TextRenderer::Load(std::string fontFile, unsigned int fontSize) {
-  this->characters.clear();
- 
+TextRenderer::~TextRenderer() {
+  glDeleteTextures(1, &this->atlas.id);
+  glDeleteVertexArrays(1, &this->VAO);
+  glDeleteBuffers(1, &this->VBO);
+  glDeleteVertexArrays(1, &this->labelVAO);
+  glDeleteBuffers(1, &this->labelVBO);
+}
+
+void TextRenderer::Load(std::string fontFile, unsigned int fontSize, GlyphMode mode) {
   stbtt_fontinfo font;
-  float scale, xpos = 2; // leave a little padding in case the character extends left
+  float scale;
 
-  std::ifstream file(fontFile, std::ios::binary | std::ios::ate);
-  std::streamsize size = file.tellg();
-  file.seekg(0, std::ios::beg);
+  // distance fields need their own fragment shader to turn distance into coverage
+  if (mode == GlyphMode::SDF) {
+    this->textShader = ResourceManager::LoadShader("resources/shaders/text_batch.vs", "resources/shaders/text_sdf.fs", nullptr, "text_sdf");
+  } else {
+    this->textShader = ResourceManager::LoadShader("resources/shaders/text_batch.vs", "resources/shaders/text_batch.fs", nullptr, "text");
+  }
+  const Shader& shader = ResourceManager::GetShader(this->textShader);
+  shader.SetMatrix4("projection", this->projection, true);
+  shader.SetInteger("text", 0);
 
-  char* fileBuffer = (char*)malloc(size);
-  if (!file.read(fileBuffer, size)) {
+  MappedFile file(fontFile);
+  if (!file.IsOpen()) {
     std::cout << "Failed to read font file" << std::endl;
     return;
   }
 
-  stbtt_InitFont(&font, (uint8_t*)fileBuffer, stbtt_GetFontOffsetForIndex((uint8_t*)fileBuffer, 0));
+  // rasterizing is skipped altogether if this font file was cached at this size before
+  uint64_t pathHash = HashBytes(fontFile.data(), fontFile.size());
+  uint64_t fileHash = HashBytes(file.GetData(), file.GetSize());
+  char cacheName[32];
+  std::snprintf(cacheName, sizeof(cacheName), "%016llx-%u%s.atlas", (unsigned long long)pathHash, fontSize,
+    mode == GlyphMode::SDF ? "-sdf" : "");
+  std::string cachePath = std::string(ATLAS_CACHE_DIRECTORY) + cacheName;
+  if (LoadAtlasCache(cachePath, pathHash, fileHash, fontSize, mode, this->characters, this->atlas)) {
+    return;
+  }
 
-  scale = stbtt_ScaleForPixelHeight(&font, (float)fontSize);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  for (GLubyte c = 0; c < 128; c++) {
-    int width, height, xOffset, yOffset, advance, leftSideBearing;
-    unsigned char* fontBitmap = stbtt_GetCodepointBitmap(&font, scale, scale, c, &width, &height, &xOffset, &yOffset);
+  stbtt_InitFont(&font, file.GetData(), stbtt_GetFontOffsetForIndex(file.GetData(), 0));
+
+  unsigned int rasterSize = mode == GlyphMode::SDF ? SDF_RASTER_SIZE : fontSize;
+  scale = stbtt_ScaleForPixelHeight(&font, (float)rasterSize);
+  // glyph metrics are kept in pixels at the font size, not the raster size
+  float metricScale = (float)fontSize / rasterSize;
+  unsigned char* bitmaps[GLYPH_COUNT];
+  glm::ivec2 bitmapSizes[GLYPH_COUNT];
+  glm::ivec2 positions[GLYPH_COUNT];
+  int maxGlyphWidth = 0;
+  for (unsigned int c = 0; c < GLYPH_COUNT; c++) {
+    int width = 0, height = 0, xOffset = 0, yOffset = 0, advance, leftSideBearing;
+    if (mode == GlyphMode::SDF) {
+      bitmaps[c] = stbtt_GetCodepointSDF(&font, scale, c, SDF_PADDING, SDF_ON_EDGE, (float)SDF_ON_EDGE / SDF_PADDING,
+        &width, &height, &xOffset, &yOffset);
+    } else {
+      bitmaps[c] = stbtt_GetCodepointBitmap(&font, scale, scale, c, &width, &height, &xOffset, &yOffset);
+    }
     stbtt_GetCodepointHMetrics(&font, c, &advance, &leftSideBearing);
+    bitmapSizes[c] = glm::ivec2(width, height);
+    maxGlyphWidth = std::max(maxGlyphWidth, width);
 
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(
-      GL_TEXTURE_2D,
-      0,
-      GL_RED,
-      width,
-      height,
-      0,
-      GL_RED,
-      GL_UNSIGNED_BYTE,
-      fontBitmap
-    );
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    Character character = {
-        texture,
-        glm::ivec2(width, height),
-        glm::ivec2(xOffset, yOffset),
+    this->characters[c] = {
+        glm::vec2(0.0f),
+        glm::vec2(0.0f),
+        glm::vec2(width * metricScale, height * metricScale),
+        glm::vec2(xOffset * metricScale, yOffset * metricScale),
         advance
     };
-    characters.insert(std::pair<char, Character>(c, character));
-    stbtt_FreeBitmap(fontBitmap, 0);
   }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
-  free(fileBuffer);
+  // pack the glyphs left to right into shelves as tall as their tallest glyph, returning the atlas height
+  auto packShelves = [&](unsigned int atlasWidth) {
+    int x = ATLAS_PADDING, y = ATLAS_PADDING, shelfHeight = 0;
+    for (unsigned int c = 0; c < GLYPH_COUNT; c++) {
+      glm::ivec2 size = bitmapSizes[c];
+      if (x + size.x + ATLAS_PADDING > (int)atlasWidth) {
+        x = ATLAS_PADDING;
+        y += shelfHeight + ATLAS_PADDING;
+        shelfHeight = 0;
+      }
+      positions[c] = glm::ivec2(x, y);
+      x += size.x + ATLAS_PADDING;
+      shelfHeight = std::max(shelfHeight, size.y);
+    }
+    return (unsigned int)(y + shelfHeight + ATLAS_PADDING);
+  };
+  // every glyph has to fit on a shelf of its own, padding included, or it would spill into the next row
+  unsigned int atlasWidth = MIN_ATLAS_WIDTH;
+  while (atlasWidth < (unsigned int)(maxGlyphWidth + 2 * ATLAS_PADDING)) {
+    atlasWidth *= 2;
+  }
+  // at big font sizes a narrow atlas gets taller than textures may be, so widen it until it's about square
+  unsigned int atlasHeight = packShelves(atlasWidth);
+  while (atlasHeight > atlasWidth) {
+    atlasWidth *= 2;
+    atlasHeight = packShelves(atlasWidth);
+  }
+
+  std::vector<unsigned char> pixels(atlasWidth * atlasHeight, 0);
+  for (unsigned int c = 0; c < GLYPH_COUNT; c++) {
+    Character& ch = this->characters[c];
+    glm::ivec2 size = bitmapSizes[c];
+    for (int row = 0; row < size.y; row++) {
+      memcpy(&pixels[(positions[c].y + row) * atlasWidth + positions[c].x], &bitmaps[c][row * size.x], size.x);
+    }
+    ch.uvMin = glm::vec2((float)positions[c].x / atlasWidth, (float)positions[c].y / atlasHeight);
+    ch.uvMax = glm::vec2((float)(positions[c].x + size.x) / atlasWidth, (float)(positions[c].y + size.y) / atlasHeight);
+    stbtt_FreeBitmap(bitmaps[c], 0);
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  this->atlas.Generate(atlasWidth, atlasHeight, pixels.data());
+  SaveAtlasCache(cachePath, pathHash, fileHash, fontSize, mode, this->characters, atlasWidth, atlasHeight, pixels);
 }
 
-void TextRenderer::RenderText(std::string text, float x, float y, float scale, glm::vec3 color) {
-  // activate corresponding render state	
-  this->textShader.Use();
-  this->textShader.SetVector3f("textColor", color);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glActiveTexture(GL_TEXTURE0);
-  glBindVertexArray(this->VAO);
+void TextRenderer::RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
+  size_t first = this->vertices.size();
+  this->vertices.resize(first + text.size() * 6 * FLOATS_PER_VERTEX);
+  LayoutText(text.data(), text.size(), x, y, scale, color, &this->vertices[first]);
+}
 
-  // iterate through all characters
-  std::string::const_iterator c;
-  for (c = text.begin(); c != text.end(); c++) {
-    Character ch = characters[*c];
+void TextRenderer::LayoutText(const char* text, size_t length, float x, float y, float scale, glm::vec3 color, float* out) {
+  for (size_t i = 0; i < length; i++) {
+    const Character& ch = this->characters[(unsigned char)text[i] % GLYPH_COUNT];
 
     float xpos = x + ch.bearing.x * scale;
     float ypos = y + ch.bearing.y * scale;
 
     float w = ch.size.x * scale;
     float h = ch.size.y * scale;
-    // update VBO for each character
-    float vertices[6][4] = {
-        { xpos,     ypos + h,   0.0f, 1.0f },
-        { xpos + w, ypos,       1.0f, 0.0f },
-        { xpos,     ypos,       0.0f, 0.0f },
-
-        { xpos,     ypos + h,   0.0f, 1.0f },
-        { xpos + w, ypos + h,   1.0f, 1.0f },
-        { xpos + w, ypos,       1.0f, 0.0f }
+    float quad[6][4] = {
+        { xpos,     ypos + h,   ch.uvMin.x, ch.uvMax.y },
+        { xpos + w, ypos,       ch.uvMax.x, ch.uvMin.y },
+        { xpos,     ypos,       ch.uvMin.x, ch.uvMin.y },
+
+        { xpos,     ypos + h,   ch.uvMin.x, ch.uvMax.y },
+        { xpos + w, ypos + h,   ch.uvMax.x, ch.uvMax.y },
+        { xpos + w, ypos,       ch.uvMax.x, ch.uvMin.y }
     };
-    // render glyph texture over quad
-    glBindTexture(GL_TEXTURE_2D, ch.textureId);
-    // update content of VBO memory
-    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    // render quad
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    for (auto& vertex : quad) {
+      memcpy(out, vertex, sizeof(vertex));
+      out[4] = color.x;
+      out[5] = color.y;
+      out[6] = color.z;
+      out += FLOATS_PER_VERTEX;
+    }
     // now advance cursors for next glyph
     x += (ch.advance >> 6) * scale; // bitshift by 6 to get value in pixels (1/64th times 2^6 = 64)
   }
+}
+
+void TextRenderer::Flush() {
+  if (this->vertices.empty()) {
+    return;
+  }
+
+  // upload every queued quad at once, only growing the buffer when it's too small
+  size_t size = this->vertices.size() * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+  if (size > this->vertexBufferSize) {
+    glBufferData(GL_ARRAY_BUFFER, size, this->vertices.data(), GL_DYNAMIC_DRAW);
+    this->vertexBufferSize = size;
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, this->vertices.data());
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  DrawVertices(this->VAO, this->vertices.size() / FLOATS_PER_VERTEX);
+  this->vertices.clear();
+}
+
+unsigned int TextRenderer::AddLabel(const std::string& text, float x, float y, float scale, glm::vec3 color, unsigned int capacity) {
+  Label label = { x, y, scale, color, "", (unsigned int)(this->labelVertices.size() / FLOATS_PER_VERTEX), std::max(capacity, (unsigned int)text.size()) };
+  label.text.reserve(label.capacity);
+  this->labels.push_back(label);
+  // start out as empty quads, the buffer is reallocated on the next RenderLabels
+  this->labelVertices.resize(this->labelVertices.size() + label.capacity * 6 * FLOATS_PER_VERTEX, 0.0f);
+
+  unsigned int handle = (unsigned int)this->labels.size() - 1;
+  SetLabelText(handle, text.c_str());
+  return handle;
+}
+
+void TextRenderer::SetLabelText(unsigned int handle, const char* text) {
+  Label& label = this->labels[handle];
+  size_t length = strnlen(text, label.capacity);
+  if (label.text.compare(0, std::string::npos, text, length) == 0) {
+    return;
+  }
+
+  size_t begin = label.firstVertex * FLOATS_PER_VERTEX;
+  size_t end = begin + label.capacity * 6 * FLOATS_PER_VERTEX;
+  LayoutText(text, length, label.x, label.y, label.scale, label.color, &this->labelVertices[begin]);
+  // collapse glyph slots the old text used and the new one doesn't
+  size_t used = begin + length * 6 * FLOATS_PER_VERTEX;
+  std::fill(this->labelVertices.begin() + used, this->labelVertices.begin() + end, 0.0f);
+  label.text.assign(text, length);
+
+  if (this->dirtyBegin == this->dirtyEnd) {
+    this->dirtyBegin = begin;
+    this->dirtyEnd = end;
+  } else {
+    this->dirtyBegin = std::min(this->dirtyBegin, begin);
+    this->dirtyEnd = std::max(this->dirtyEnd, end);
+  }
+}
+
+void TextRenderer::RenderLabels() {
+  if (this->labelVertices.empty()) {
+    return;
+  }
+
+  size_t size = this->labelVertices.size() * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, this->labelVBO);
+  if (size != this->labelBufferSize) {
+    // labels were added, upload all of them
+    glBufferData(GL_ARRAY_BUFFER, size, this->labelVertices.data(), GL_DYNAMIC_DRAW);
+    this->labelBufferSize = size;
+  } else if (this->dirtyBegin != this->dirtyEnd) {
+    glBufferSubData(GL_ARRAY_BUFFER, this->dirtyBegin * sizeof(float), (this->dirtyEnd - this->dirtyBegin) * sizeof(float),
+      &this->labelVertices[this->dirtyBegin]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  this->dirtyBegin = this->dirtyEnd = 0;
+
+  DrawVertices(this->labelVAO, this->labelVertices.size() / FLOATS_PER_VERTEX);
+}
+
+void TextRenderer::DrawVertices(unsigned int vao, size_t vertexCount) {
+  // activate corresponding render state
+  ResourceManager::GetShader(this->textShader).Use();
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glActiveTexture(GL_TEXTURE0);
+  this->atlas.Bind();
+  glBindVertexArray(vao);
+  glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertexCount);
   glBindVertexArray(0);
   glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+}
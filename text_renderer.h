@@ -1,28 +1,83 @@
 #pragma once
-#include <map>
+#include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include "texture.h"
-#include "shader.h"
+#include "resource_manager.h"
+
+// glyphs are loaded for the ASCII range only
+constexpr unsigned int GLYPH_COUNT = 128;
+
+enum class GlyphMode {
+  // coverage bitmaps rasterized at the font size, blurry when drawn at any other scale
+  BITMAP,
+  // signed distance fields rasterized at SDF_RASTER_SIZE, sharp at any scale
+  SDF,
+};
 
 struct Character {
-  unsigned int textureId;
-  glm::ivec2 size;
-  glm::ivec2 bearing;
+  // where the glyph's bitmap is in the atlas, in texture coordinates
+  glm::vec2 uvMin;
+  glm::vec2 uvMax;
+  // in pixels at the font size, whatever size the glyph was rasterized at
+  glm::vec2 size;
+  glm::vec2 bearing;
   int advance;
 };
 
+// Text that stays on screen across frames, see TextRenderer::AddLabel
+struct Label {
+  float x, y, scale;
+  glm::vec3 color;
+  std::string text;
+  // the label's slot in the label vertex buffer, room for capacity glyphs
+  unsigned int firstVertex;
+  unsigned int capacity;
+};
+
 class TextRenderer {
 public:
-  std::map<char, Character> characters;
-  Shader textShader;
+  Character characters[GLYPH_COUNT];
+  ShaderHandle textShader;
+  // every glyph's bitmap, packed into one texture so a whole batch of text needs one bind
+  Texture2D atlas;
 
   TextRenderer(unsigned int width, unsigned int height);
+  ~TextRenderer();
 
-  void Load(std::string font, unsigned int fontSize);
-  void RenderText(std::string text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f));
+  void Load(std::string font, unsigned int fontSize, GlyphMode mode = GlyphMode::BITMAP);
+  // queues the text's quads, nothing is drawn until the next Flush
+  void RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f));
+  // draws all text queued since the last Flush with a single draw call
+  void Flush();
+
+  // adds text that is laid out once and kept on the GPU until it changes, returning its handle.
+  // capacity is the most characters SetLabelText may give it, by default the length of text
+  unsigned int AddLabel(const std::string& text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f), unsigned int capacity = 0);
+  // lays the label out again only if text differs from what it shows, cutting text off at its capacity
+  void SetLabelText(unsigned int label, const char* text);
+  // draws every label with a single draw call, uploading only the labels that changed
+  void RenderLabels();
 private:
+  glm::mat4 projection;
   unsigned int VAO, VBO;
-};
\ No newline at end of file
+  // x, y, u, v, r, g, b for every vertex of every queued quad
+  std::vector<float> vertices;
+  size_t vertexBufferSize = 0;
+
+  unsigned int labelVAO, labelVBO;
+  std::vector<Label> labels;
+  // every label's vertices as they are in labelVBO, unused glyph slots are left as empty quads
+  std::vector<float> labelVertices;
+  size_t labelBufferSize = 0;
+  // range of labelVertices, in floats, that changed since the last upload
+  size_t dirtyBegin = 0, dirtyEnd = 0;
+
+  void CreateVertexArray(unsigned int* vao, unsigned int* vbo);
+  // writes six vertices for each of the length characters of text into out
+  void LayoutText(const char* text, size_t length, float x, float y, float scale, glm::vec3 color, float* out);
+  void DrawVertices(unsigned int vao, size_t vertexCount);
+};
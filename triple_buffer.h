@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Hands the latest value from one producer thread to one consumer thread without locks.
+// The producer and consumer each own one of the three slots and the third is shared,
+// so neither side ever waits. Values the consumer doesn't get to in time are dropped.
+template <typename T>
+class TripleBuffer {
+public:
+	// Producer only: the slot to fill in before calling Publish
+	T& GetWriteBuffer() {
+		return buffers[writeIndex];
+	}
+
+	// Producer only: makes the write buffer the latest value and takes back a free slot
+	void Publish() {
+		writeIndex = shared.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Consumer only: switches to the latest published value, if there is a new one
+	bool Acquire() {
+		if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+			return false;
+		}
+		readIndex = shared.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	// Consumer only: the value taken by the last successful Acquire
+	const T& GetReadBuffer() const {
+		return buffers[readIndex];
+	}
+
+private:
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	// Set in the shared index when it holds a value the consumer hasn't seen
+	static constexpr uint8_t FRESH = 0x4;
+
+	T buffers[3];
+	uint8_t writeIndex = 0;
+	std::atomic<uint8_t> shared{ 1 };
+	uint8_t readIndex = 2;
+};
@@ -0,0 +1,75 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(unsigned int threadCount) {
+	for (unsigned int i = 1; i < threadCount; i++) {
+		threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	startCondition.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+unsigned int WorkerPool::GetThreadCount() {
+	return (unsigned int)threads.size() + 1;
+}
+
+void WorkerPool::Run(unsigned int count, const std::function<void(unsigned int)>& job) {
+	if (threads.empty() || count <= 1) {
+		for (unsigned int i = 0; i < count; i++) {
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		jobCount = count;
+		nextJob = 0;
+		busyWorkers = (unsigned int)threads.size();
+		generation++;
+	}
+	startCondition.notify_all();
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+	this->job = nullptr;
+}
+
+void WorkerPool::WorkerLoop() {
+	uint64_t lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startCondition.wait(lock, [this, lastGeneration] { return stopping || generation != lastGeneration; });
+			if (stopping) {
+				return;
+			}
+			lastGeneration = generation;
+		}
+
+		RunJobs();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		busyWorkers--;
+		if (busyWorkers == 0) {
+			doneCondition.notify_one();
+		}
+	}
+}
+
+void WorkerPool::RunJobs() {
+	unsigned int i;
+	while ((i = nextJob.fetch_add(1)) < jobCount) {
+		(*job)(i);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run batches of independent jobs.
+// The thread calling Run works through the batch too, so a pool
+// created with a thread count of 1 runs everything inline.
+class WorkerPool {
+public:
+	WorkerPool(unsigned int threadCount);
+	~WorkerPool();
+
+	unsigned int GetThreadCount();
+	// Calls job(i) for every i in [0, count) and returns once all calls have finished
+	void Run(unsigned int count, const std::function<void(unsigned int)>& job);
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(unsigned int)>* job = nullptr;
+	unsigned int jobCount = 0;
+	std::atomic<unsigned int> nextJob{ 0 };
+	unsigned int busyWorkers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	void WorkerLoop();
+	void RunJobs();
+};